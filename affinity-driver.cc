@@ -0,0 +1,147 @@
+/**
+ * File: affinity-driver.cc
+ * ------------------------
+ * A standalone driver that measures what keying article downloads by host
+ * (ThreadPool::schedule(key, thunk)) buys.  It downloads every URL in the
+ * supplied file twice, once with each thunk keyed by its URL's server and
+ * once unkeyed, each time through a fresh HttpFetcher, and reports how many
+ * connections libcurl opened (CURLINFO_NUM_CONNECTS, summed over requests),
+ * how many distinct workers served each host, and how long it all took.
+ *
+ * Thunks are scheduled the way NewsAggregator::scheduleArticles schedules
+ * them: each one pops the next URL of its host rather than carrying one of
+ * its own, so what's measured is affinity by host, not by article.
+ *
+ * Usage: affinity-driver <url-file> [<num-workers>] [--multiplex]
+ *
+ * The URL file lists one http or https URL per line, ideally interleaved
+ * across hosts the way feeds interleave them.  Without --multiplex, requests
+ * speak HTTP/1.1, where every concurrent request to a host needs a connection
+ * of its own and affinity has the most to offer.
+ */
+
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "http-fetcher.h"
+#include "thread-pool.h"
+#include "utils.h"
+using namespace std;
+using develop::ThreadPool;
+
+static const size_t kDefaultNumWorkers = 50; // As many as the aggregator's article pool.
+
+/**
+ * Struct: RunResult
+ * -----------------
+ * What one pass over the URLs measured.
+ */
+struct RunResult {
+  size_t numFetched = 0;
+  size_t numFailed = 0;
+  size_t numConnections = 0;
+  double workersPerHost = 0;
+  double elapsedMS = 0;
+};
+
+static RunResult crawl(const vector<string>& urls, size_t numWorkers, bool keyed, bool multiplex) {
+  HttpFetcher::Options options;
+  options.multiplex = multiplex;
+  HttpFetcher fetcher(options);
+
+  mutex lock; // Protects everything below.
+  map<string, deque<string>> pendingByHost;
+  map<string, set<thread::id>> workersByHost;
+  vector<string> hosts;
+  for (const string& url : urls) {
+    string host = getURLServer(url);
+    pendingByHost[host].push_back(url);
+    hosts.push_back(host);
+  }
+
+  RunResult result;
+  chrono::steady_clock::time_point start = chrono::steady_clock::now();
+  {
+    ThreadPool pool(numWorkers);
+    for (const string& host : hosts) {
+      auto fetchNext = [&, host] {
+        string url;
+        lock.lock();
+        url = pendingByHost[host].front();
+        pendingByHost[host].pop_front();
+        workersByHost[host].insert(this_thread::get_id());
+        lock.unlock();
+
+        string body;
+        HttpFetcher::Limits limits;
+        bool fetched = fetcher.fetch(url, body, limits);
+        lock_guard<mutex> lg(lock);
+        if (fetched) result.numFetched++;
+        else result.numFailed++;
+      };
+      if (keyed) pool.schedule(host, fetchNext);
+      else pool.schedule(fetchNext);
+    }
+    pool.wait();
+  }
+  result.elapsedMS = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+  result.numConnections = fetcher.getNumConnections();
+  size_t numWorkerHosts = 0;
+  for (const pair<const string, set<thread::id>>& entry : workersByHost) numWorkerHosts += entry.second.size();
+  result.workersPerHost = double(numWorkerHosts) / workersByHost.size();
+  return result;
+}
+
+static void printResult(const string& label, const RunResult& result) {
+  cout << label << ": " << result.numFetched << " fetched, " << result.numFailed << " failed, "
+       << result.numConnections << " connections opened, " << result.workersPerHost
+       << " workers per host, " << result.elapsedMS << " ms" << endl;
+}
+
+int main(int argc, char *argv[]) {
+  if (argc < 2) {
+    cerr << "Usage: " << argv[0] << " <url-file> [<num-workers>] [--multiplex]" << endl;
+    return 1;
+  }
+  ifstream urlFile(argv[1]);
+  if (!urlFile) {
+    cerr << "Unable to read \"" << argv[1] << "\"." << endl;
+    return 1;
+  }
+  vector<string> urls;
+  string url;
+  while (getline(urlFile, url)) {
+    if (HttpFetcher::canFetch(url)) urls.push_back(url);
+  }
+  if (urls.empty()) {
+    cerr << "\"" << argv[1] << "\" lists no http or https URLs." << endl;
+    return 1;
+  }
+
+  size_t numWorkers = kDefaultNumWorkers;
+  bool multiplex = false;
+  for (int i = 2; i < argc; i++) {
+    if (strcmp(argv[i], "--multiplex") == 0) multiplex = true;
+    else numWorkers = strtoul(argv[i], NULL, 10);
+  }
+  if (numWorkers == 0) {
+    cerr << "The number of workers must be positive." << endl;
+    return 1;
+  }
+
+  cout << urls.size() << " URLs, " << numWorkers << " workers, "
+       << (multiplex ? "multiplexed" : "HTTP/1.1") << endl;
+  printResult("keyed by host", crawl(urls, numWorkers, true, multiplex));
+  printResult("unkeyed", crawl(urls, numWorkers, false, multiplex));
+  return 0;
+}
@@ -0,0 +1,154 @@
+/**
+ * File: body-token-cache.cc
+ * -------------------------
+ * Presents the implementation of the BodyTokenCache class.
+ */
+
+#include "body-token-cache.h"
+
+#include <random>
+using namespace std;
+
+namespace {
+/**
+ * Class: SipHasher
+ * ----------------
+ * Computes SipHash-2-4 over bytes fed one at a time.
+ */
+class SipHasher {
+ public:
+  SipHasher(const uint64_t key[2])
+    : v0(key[0] ^ 0x736f6d6570736575ULL), v1(key[1] ^ 0x646f72616e646f6dULL),
+      v2(key[0] ^ 0x6c7967656e657261ULL), v3(key[1] ^ 0x7465646279746573ULL) {}
+
+  void add(unsigned char byte) {
+    word |= uint64_t(byte) << (8 * (length % 8));
+    length++;
+    if (length % 8 == 0) {
+      compress(word);
+      word = 0;
+    }
+  }
+
+  uint64_t finish() {
+    compress(word | uint64_t(length) << 56);
+    v2 ^= 0xff;
+    for (int i = 0; i < 4; i++) round();
+    return v0 ^ v1 ^ v2 ^ v3;
+  }
+
+  size_t getLength() const { return length; }
+
+ private:
+  uint64_t v0, v1, v2, v3;
+  uint64_t word = 0; // The bytes since the last full word, little-endian.
+  size_t length = 0;
+
+  static uint64_t rotate(uint64_t x, int bits) { return (x << bits) | (x >> (64 - bits)); }
+
+  void round() {
+    v0 += v1; v1 = rotate(v1, 13); v1 ^= v0; v0 = rotate(v0, 32);
+    v2 += v3; v3 = rotate(v3, 16); v3 ^= v2;
+    v0 += v3; v3 = rotate(v3, 21); v3 ^= v0;
+    v2 += v1; v1 = rotate(v1, 17); v1 ^= v2; v2 = rotate(v2, 32);
+  }
+
+  void compress(uint64_t m) {
+    v3 ^= m;
+    round();
+    round();
+    v0 ^= m;
+  }
+};
+}
+
+static bool isWhitespace(char ch) {
+  return ch == ' ' || ch == '\t' || ch == '\n' || ch == '\r' || ch == '\f' || ch == '\v';
+}
+
+BodyTokenCache::BodyKey BodyTokenCache::hashBody(const string& body) const {
+  // The body is hashed with each whitespace run read as a single space and the ends trimmed.
+  SipHasher hasher(hashKey);
+  bool pendingSpace = false;
+  for (char ch : body) {
+    if (isWhitespace(ch)) {
+      pendingSpace = hasher.getLength() > 0;
+      continue;
+    }
+    if (pendingSpace) {
+      hasher.add(' ');
+      pendingSpace = false;
+    }
+    hasher.add(static_cast<unsigned char>(ch));
+  }
+  return {hasher.finish(), hasher.getLength()};
+}
+
+// Roughly what the map node, the shared vector's control block and its allocation add to the counts themselves.
+static const size_t kEntryOverhead = 128;
+
+BodyTokenCache::BodyTokenCache(size_t maxBytes) : maxBytesPerStripe(maxBytes / kNumStripes) {
+  random_device entropy;
+  for (uint64_t& half : hashKey) half = uint64_t(entropy()) << 32 | entropy();
+}
+
+shared_ptr<const vector<TokenCount>> BodyTokenCache::find(const BodyKey& key) const {
+  const Stripe& stripe = stripeFor(key);
+  lock_guard<mutex> lg(stripe.lock);
+  auto found = stripe.entries.find(key.hash);
+  if (found == stripe.entries.end() || found->second.length != key.length) return nullptr;
+  found->second.referenced = true;
+  found->second.lastUsed = chrono::steady_clock::now();
+  return found->second.counts;
+}
+
+void BodyTokenCache::insert(const BodyKey& key, const vector<TokenCount>& counts) {
+  size_t numBytes = counts.size() * sizeof(TokenCount) + kEntryOverhead;
+  if (numBytes > maxBytesPerStripe) return;
+  shared_ptr<const vector<TokenCount>> shared = make_shared<const vector<TokenCount>>(counts);
+  Stripe& stripe = stripeFor(key);
+  lock_guard<mutex> lg(stripe.lock);
+  if (stripe.entries.count(key.hash)) return;
+  while (stripe.numBytes + numBytes > maxBytesPerStripe) {
+    if (stripe.hand >= stripe.clock.size()) stripe.hand = 0;
+    Entry& candidate = stripe.entries.at(stripe.clock[stripe.hand]);
+    if (candidate.referenced) {
+      candidate.referenced = false;
+      stripe.hand++;
+    } else {
+      evict(stripe, stripe.hand);
+    }
+  }
+  stripe.entries.emplace(key.hash, Entry{key.length, shared, numBytes, false,
+                                         chrono::steady_clock::now()});
+  stripe.clock.push_back(key.hash);
+  stripe.numBytes += numBytes;
+}
+
+size_t BodyTokenCache::expire(chrono::steady_clock::duration maxIdle) {
+  chrono::steady_clock::time_point cutoff = chrono::steady_clock::now() - maxIdle;
+  size_t numExpired = 0;
+  for (Stripe& stripe : stripes) {
+    lock_guard<mutex> lg(stripe.lock);
+    size_t slot = 0;
+    while (slot < stripe.clock.size()) {
+      if (stripe.entries.at(stripe.clock[slot]).lastUsed >= cutoff) {
+        slot++;
+        continue;
+      }
+      evict(stripe, slot);
+      numExpired++;
+    }
+  }
+  return numExpired;
+}
+
+void BodyTokenCache::evict(Stripe& stripe, size_t slot) {
+  // The last hash in the clock takes over the evicted one's slot, so the clock stays dense.
+  auto evicted = stripe.entries.find(stripe.clock[slot]);
+  stripe.numBytes -= evicted->second.numBytes;
+  stripe.entries.erase(evicted);
+  uint64_t moved = stripe.clock.back();
+  stripe.clock.pop_back();
+  if (slot < stripe.clock.size()) stripe.clock[slot] = moved;
+}
@@ -0,0 +1,118 @@
+/**
+ * File: body-token-cache.h
+ * ------------------------
+ * Defines the BodyTokenCache class, which remembers the token counts already
+ * computed for each distinct article body.  Syndicated articles are often
+ * byte-for-byte identical across URLs and servers, so a body that hashes the
+ * same as one seen before can reuse its token counts and skip the parse,
+ * normalization and interning altogether.
+ *
+ * Bodies are hashed after collapsing runs of whitespace, so copies that differ
+ * only in line endings or indentation still match.  The hash is SipHash-2-4
+ * under a key each cache draws at random, so that a page can't be crafted
+ * to collide with another and be indexed under its tokens.  Like the
+ * TokenDictionary, the cache is split into independently locked stripes.
+ *
+ * Each stripe holds at most its share of a fixed byte budget.  When an insert
+ * would exceed it, a clock hand sweeps the stripe's entries, sparing (once)
+ * any that were found since it last passed and evicting the rest until the
+ * new entry fits.  Entries that go unused for long enough can also be expired
+ * outright, so that a long run of feed refreshes doesn't keep every body it
+ * ever saw.
+ */
+
+#pragma once
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "token-dictionary.h"
+
+class BodyTokenCache {
+ public:
+/**
+ * Constructor: BodyTokenCache
+ * ---------------------------
+ * Constructs an empty cache whose entries take up at most (roughly)
+ * maxBytes in all.
+ */
+  BodyTokenCache(size_t maxBytes = kDefaultMaxBytes);
+
+/**
+ * Struct: BodyKey
+ * ---------------
+ * Identifies a body by the keyed hash and length of its whitespace-collapsed
+ * form.
+ */
+  struct BodyKey {
+    uint64_t hash;
+    size_t length;
+  };
+
+/**
+ * Method: hashBody
+ * ----------------
+ * Computes the key of the supplied raw response body under this cache's
+ * hash key.
+ */
+  BodyKey hashBody(const std::string& body) const;
+
+/**
+ * Method: find
+ * ------------
+ * Returns the token counts recorded for the supplied body, or nullptr
+ * if no body with the same key has been recorded.
+ */
+  std::shared_ptr<const std::vector<TokenCount>> find(const BodyKey& key) const;
+
+/**
+ * Method: insert
+ * --------------
+ * Records the token counts computed for the supplied body, evicting older
+ * entries as needed to stay within budget.  If another thread got there
+ * first, its entry is kept.
+ */
+  void insert(const BodyKey& key, const std::vector<TokenCount>& counts);
+
+/**
+ * Method: expire
+ * --------------
+ * Evicts every entry that hasn't been found or inserted within the last
+ * maxIdle.  Returns the number of entries evicted.
+ */
+  size_t expire(std::chrono::steady_clock::duration maxIdle);
+
+ private:
+  static const size_t kNumStripes = 64;
+  static const size_t kDefaultMaxBytes = 64 << 20;
+
+  struct Entry {
+    size_t length;
+    std::shared_ptr<const std::vector<TokenCount>> counts;
+    size_t numBytes;
+    mutable bool referenced;
+    mutable std::chrono::steady_clock::time_point lastUsed;
+  };
+
+  struct alignas(64) Stripe {
+    mutable std::mutex lock;
+    std::unordered_map<uint64_t, Entry> entries;
+    std::vector<uint64_t> clock; // The hash of every entry, in no particular order.
+    size_t hand = 0;
+    size_t numBytes = 0;
+  };
+
+  uint64_t hashKey[2]; // Drawn at random when the cache is constructed.
+  size_t maxBytesPerStripe;
+  std::array<Stripe, kNumStripes> stripes;
+
+  static void evict(Stripe& stripe, size_t slot);
+
+  Stripe& stripeFor(const BodyKey& key) { return stripes[key.hash % kNumStripes]; }
+  const Stripe& stripeFor(const BodyKey& key) const { return stripes[key.hash % kNumStripes]; }
+};
@@ -0,0 +1,55 @@
+/**
+ * File: concurrent-rss-index.cc
+ * -----------------------------
+ * Presents the implementation of the ConcurrentRSSIndex class.
+ */
+
+#include "concurrent-rss-index.h"
+
+#include <algorithm>
+using namespace std;
+
+void ConcurrentRSSIndex::addBatch(const vector<const ArticleTokenCounts *>& batch) {
+  if (batch.empty()) return;
+  lock_guard<mutex> lg(lock);
+  uint32_t firstArticleID = articles.size();
+  for (const ArticleTokenCounts *entry : batch) articles.push_back(entry->first);
+
+  // Size the postings up front so the append loop never has to check.
+  TokenID maxID = 0;
+  for (const ArticleTokenCounts *entry : batch) {
+    if (!entry->second.empty()) maxID = max(maxID, entry->second.back().id);
+  }
+  if (postings.size() <= maxID) postings.resize(maxID + 1);
+
+  for (size_t i = 0; i < batch.size(); i++) {
+    uint32_t articleID = firstArticleID + i;
+    for (const TokenCount& token : batch[i]->second) postings[token.id].push_back({articleID, token.count});
+  }
+}
+
+shared_ptr<const IndexSnapshot> ConcurrentRSSIndex::snapshot() const {
+  return snapshot(vector<const ArticleTokenCounts *>());
+}
+
+shared_ptr<const IndexSnapshot> ConcurrentRSSIndex::snapshot(const vector<const ArticleTokenCounts *>& pending) const {
+  // Terms are listed under the lock, so every token of every batch added so far is among them.
+  lock.lock();
+  vector<string> terms = dictionary.getTerms();
+  vector<Article> articlesCopy = articles;
+  vector<vector<IndexSnapshot::Posting>> postingsByToken(terms.size());
+  for (size_t id = 0; id < postings.size(); id++) {
+    for (const Posting& posting : postings[id]) postingsByToken[id].push_back({posting.articleID, posting.count});
+  }
+  lock.unlock();
+
+  // The pending articles' IDs follow every indexed one, so each posting list stays sorted by article ID.
+  for (const ArticleTokenCounts *articleTokens : pending) {
+    uint32_t articleID = articlesCopy.size();
+    articlesCopy.push_back(articleTokens->first);
+    for (const TokenCount& token : articleTokens->second) {
+      if (token.id < terms.size()) postingsByToken[token.id].push_back({articleID, token.count});
+    }
+  }
+  return make_shared<IndexSnapshot>(nextGeneration++, terms, postingsByToken, articlesCopy);
+}
@@ -0,0 +1,82 @@
+/**
+ * File: concurrent-rss-index.h
+ * ----------------------------
+ * Defines the ConcurrentRSSIndex class, the index the aggregator builds and
+ * snapshots.  Terms are interned through a striped TokenDictionary, which
+ * article workers share as they count their tokens, and each term's postings
+ * live in a per-term buffer.  Articles arrive as whole batches of (token ID,
+ * count) runs, one batch at a time, so adding them involves no hashing or
+ * string handling at all, and one lock for the whole index is all it takes.
+ */
+
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "article.h"
+#include "index-snapshot.h"
+#include "token-dictionary.h"
+
+class ConcurrentRSSIndex {
+ public:
+/**
+ * Type: ArticleTokenCounts
+ * ------------------------
+ * An article paired with the ID-sorted counts of the tokens it contains.
+ */
+  typedef std::pair<Article, std::vector<TokenCount>> ArticleTokenCounts;
+
+/**
+ * Method: addBatch
+ * ----------------
+ * Adds many articles at once, each with token counts whose IDs came from this
+ * index's dictionary.  The index is locked once for the whole batch, during
+ * which construction is a straight sequential append into the postings with
+ * no hashing or map insertion.
+ */
+  void addBatch(const std::vector<const ArticleTokenCounts *>& batch);
+
+/**
+ * Method: getDictionary
+ * ---------------------
+ * Exposes the dictionary so that callers can intern tokens up front
+ * and feed the resulting IDs to addBatch.
+ */
+  TokenDictionary& getDictionary() { return dictionary; }
+  const TokenDictionary& getDictionary() const { return dictionary; }
+
+/**
+ * Method: snapshot
+ * ----------------
+ * Freezes the current contents of the index into an immutable IndexSnapshot
+ * with its own generation number.  Adds that race with the snapshot may or
+ * may not be included, but the snapshot itself never changes afterwards.
+ */
+  std::shared_ptr<const IndexSnapshot> snapshot() const;
+
+/**
+ * Method: snapshot
+ * ----------------
+ * As above, but the snapshot also includes the supplied articles, numbered
+ * after every article in the index, without adding them to the index
+ * itself.  Their token IDs must come from this index's dictionary.
+ */
+  std::shared_ptr<const IndexSnapshot> snapshot(const std::vector<const ArticleTokenCounts *>& pending) const;
+
+ private:
+  struct Posting {
+    uint32_t articleID;
+    int count;
+  };
+
+  TokenDictionary dictionary;
+  mutable std::atomic<uint64_t> nextGeneration{1};
+  mutable std::mutex lock; // Protects the postings and the article table.
+  std::vector<std::vector<Posting>> postings; // Indexed by token ID.
+  std::vector<Article> articles; // Maps article IDs back to articles.
+};
@@ -0,0 +1,298 @@
+/**
+ * File: crawl-frontier.cc
+ * -----------------------
+ * Presents the implementation of the CrawlFrontier class.
+ */
+
+#include "crawl-frontier.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <sstream>
+
+#include "utils.h"
+using namespace std;
+
+static const char kMagic[8] = {'R', 'S', 'S', 'F', 'R', 'N', 'T', '1'};
+
+// Record types.  Each of the three outcomes also marks its URL as done.
+static const uint8_t kPush = 1;
+static const uint8_t kSkipped = 2;
+static const uint8_t kSucceeded = 3;
+static const uint8_t kFailed = 4;
+static const uint8_t kHostHealth = 5; // Written by compaction; the title holds "<succeeded> <failed>".
+
+// Compact once the log holds this many records and at least four times as many as are live.
+static const size_t kMinRecordsToCompact = 4096;
+static const size_t kCompactionRatio = 4;
+
+// Rebuild a kind's queue once it holds this many stale copies and more of them than live ones.
+static const size_t kMinStaleToRebuild = 1024;
+
+static const double kSecondsPerDay = 24 * 60 * 60;
+static const double kUnknownFreshness = 0.5;
+
+/**
+ * Struct: Record
+ * --------------
+ * The fixed-size head of every log record.  The URL, title and GUID follow
+ * it back to back, and the record is padded to a multiple of eight bytes.
+ */
+struct CrawlFrontier::Record {
+  uint8_t type;
+  uint8_t kind;
+  uint16_t reserved;
+  uint32_t urlLength;
+  uint32_t titleLength;
+  uint32_t guidLength;
+  double priority;
+};
+
+static size_t getPaddedLength(size_t length) {
+  return (length + 7) & ~size_t(7);
+}
+
+CrawlFrontier::~CrawlFrontier() {
+  if (fd != -1) close(fd);
+}
+
+double CrawlFrontier::getFreshness(time_t published, time_t now) {
+  if (published == 0) return kUnknownFreshness;
+  double ageInDays = max(0.0, difftime(now, published) / kSecondsPerDay);
+  return pow(0.5, ageInDays);
+}
+
+double CrawlFrontier::getHostHealth(const string& host) const {
+  auto found = hosts.find(host);
+  if (found == hosts.end()) return 0.5;
+  const HostHealth& health = found->second;
+  return (health.numSucceeded + 1.0) / (health.numSucceeded + health.numFailed + 2.0);
+}
+
+void CrawlFrontier::insertPending(const Entry& entry) {
+  uint64_t sequence = nextSequence++;
+  pending[entry.url] = {entry, sequence};
+  ranked[entry.kind].push({entry.priority, sequence, entry.url});
+  rankedByHost[entry.kind][getURLServer(entry.url)].push({entry.priority, sequence, entry.url});
+  numPending[entry.kind]++;
+}
+
+void CrawlFrontier::applyOutcome(const string& url, Outcome outcome) {
+  auto found = pending.find(url);
+  if (found != pending.end()) {
+    numPending[found->second.entry.kind]--;
+    pending.erase(found);
+  }
+  inFlight.erase(url);
+  if (outcome == Succeeded) hosts[getURLServer(url)].numSucceeded++;
+  if (outcome == Failed) hosts[getURLServer(url)].numFailed++;
+}
+
+bool CrawlFrontier::appendRecord(int fd, uint8_t type, Kind kind, const string& url, const string& title,
+                                 const string& guid, double priority) {
+  Record record = {type, uint8_t(kind), 0, uint32_t(url.size()), uint32_t(title.size()), uint32_t(guid.size()), priority};
+  string bytes(reinterpret_cast<const char *>(&record), sizeof(record));
+  bytes += url;
+  bytes += title;
+  bytes += guid;
+  bytes.resize(getPaddedLength(bytes.size()), '\0');
+  numRecords++;
+  return write(fd, bytes.data(), bytes.size()) == ssize_t(bytes.size());
+}
+
+size_t CrawlFrontier::replay(const char *start, size_t length) {
+  size_t offset = sizeof(kMagic);
+  while (offset + sizeof(Record) <= length) {
+    Record record;
+    memcpy(&record, start + offset, sizeof(record));
+    size_t payloadLength = size_t(record.urlLength) + record.titleLength + record.guidLength;
+    size_t recordLength = getPaddedLength(sizeof(Record) + payloadLength);
+    if (record.kind > Article || record.type < kPush || record.type > kHostHealth || length - offset < recordLength) break;
+
+    const char *payload = start + offset + sizeof(Record);
+    string url(payload, record.urlLength);
+    string title(payload + record.urlLength, record.titleLength);
+    string guid(payload + record.urlLength + record.titleLength, record.guidLength);
+    if (record.type == kPush) {
+      if (!pending.count(url)) insertPending({Kind(record.kind), url, title, guid, record.priority});
+    } else if (record.type == kHostHealth) {
+      HostHealth& health = hosts[url];
+      istringstream(title) >> health.numSucceeded >> health.numFailed;
+    } else {
+      applyOutcome(url, record.type == kSucceeded ? Succeeded : record.type == kFailed ? Failed : Skipped);
+    }
+    numRecords++;
+    offset += recordLength;
+  }
+  return offset;
+}
+
+bool CrawlFrontier::open(const string& path) {
+  lock_guard<mutex> lg(lock);
+  int logFD = ::open(path.c_str(), O_RDWR | O_CREAT | O_APPEND, 0644);
+  if (logFD == -1) return false;
+  struct stat st;
+  if (fstat(logFD, &st) == -1) {
+    close(logFD);
+    return false;
+  }
+
+  size_t size = st.st_size;
+  if (size == 0) {
+    if (write(logFD, kMagic, sizeof(kMagic)) != ssize_t(sizeof(kMagic))) {
+      close(logFD);
+      return false;
+    }
+  } else {
+    void *region = size < sizeof(kMagic) ? MAP_FAILED : mmap(NULL, size, PROT_READ, MAP_PRIVATE, logFD, 0);
+    if (region == MAP_FAILED || memcmp(region, kMagic, sizeof(kMagic)) != 0) {
+      // Not a frontier log, so leave it alone.
+      if (region != MAP_FAILED) munmap(region, size);
+      close(logFD);
+      return false;
+    }
+    size_t validLength = replay(static_cast<const char *>(region), size);
+    munmap(region, size);
+    if (validLength < size && ftruncate(logFD, validLength) == -1) {
+      close(logFD);
+      return false;
+    }
+  }
+
+  // Anything popped but never completed by a previous run is simply pending again.
+  this->path = path;
+  fd = logFD;
+  compact();
+  return true;
+}
+
+void CrawlFrontier::compact() {
+  size_t numLive = pending.size() + inFlight.size() + hosts.size();
+  if (numRecords < kMinRecordsToCompact || numRecords < kCompactionRatio * numLive) return;
+
+  string compactedPath = path + ".compacting";
+  int compactedFD = ::open(compactedPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_APPEND, 0644);
+  if (compactedFD == -1) return;
+  size_t numRecordsBefore = numRecords;
+  numRecords = 0;
+  bool written = write(compactedFD, kMagic, sizeof(kMagic)) == ssize_t(sizeof(kMagic));
+  for (const pair<const string, HostHealth>& host : hosts) {
+    string counts = to_string(host.second.numSucceeded) + " " + to_string(host.second.numFailed);
+    written = written && appendRecord(compactedFD, kHostHealth, Feed, host.first, counts, "", 0);
+  }
+  // Entries being fetched right now must survive a crash too.
+  for (const pair<const string, Entry>& entry : inFlight) {
+    const Entry& e = entry.second;
+    written = written && appendRecord(compactedFD, kPush, e.kind, e.url, e.title, e.guid, e.priority);
+  }
+  // Pending entries go out in sequence order, so ties still break the same way after a restart.
+  vector<const PendingEntry *> entries;
+  for (const pair<const string, PendingEntry>& entry : pending) entries.push_back(&entry.second);
+  sort(entries.begin(), entries.end(), [](const PendingEntry *one, const PendingEntry *two) {
+    return one->sequence < two->sequence;
+  });
+  for (const PendingEntry *entry : entries) {
+    const Entry& e = entry->entry;
+    written = written && appendRecord(compactedFD, kPush, e.kind, e.url, e.title, e.guid, e.priority);
+  }
+  if (!written || fsync(compactedFD) == -1 || rename(compactedPath.c_str(), path.c_str()) == -1) {
+    close(compactedFD);
+    unlink(compactedPath.c_str());
+    numRecords = numRecordsBefore;
+    return;
+  }
+  close(fd);
+  fd = compactedFD;
+}
+
+bool CrawlFrontier::push(Kind kind, const string& url, const string& title, const string& guid,
+                         double importance, double freshness) {
+  lock_guard<mutex> lg(lock);
+  if (pending.count(url) || inFlight.count(url)) return false;
+  double priority = importance * freshness * getHostHealth(getURLServer(url));
+  Entry entry = {kind, url, title, guid, priority};
+  insertPending(entry);
+  if (fd != -1) appendRecord(fd, kPush, kind, url, title, guid, priority);
+  return true;
+}
+
+bool CrawlFrontier::pop(Kind kind, Entry& entry) {
+  lock_guard<mutex> lg(lock);
+  return popFrom(ranked[kind], entry);
+}
+
+bool CrawlFrontier::pop(Kind kind, Entry& entry, const string& preferredHost) {
+  lock_guard<mutex> lg(lock);
+  auto found = rankedByHost[kind].find(preferredHost);
+  if (found != rankedByHost[kind].end()) {
+    if (popFrom(found->second, entry)) return true;
+    rankedByHost[kind].erase(found); // nothing but stale entries
+  }
+  return popFrom(ranked[kind], entry);
+}
+
+bool CrawlFrontier::popFrom(priority_queue<Ranked>& queue, Entry& entry) {
+  while (!queue.empty()) {
+    Ranked top = queue.top();
+    queue.pop();
+    auto found = pending.find(top.url);
+    if (found == pending.end() || found->second.sequence != top.sequence) continue; // stale
+    entry = found->second.entry;
+    pending.erase(found);
+    numPending[entry.kind]--;
+    inFlight[entry.url] = entry;
+
+    // The entry's copy in the other queue is now stale.  Whatever's stale at the top of either is dropped
+    // right away; a copy buried in the queue of every kind (left there by pops that prefer a host) is
+    // dropped once enough of them pile up to be worth rebuilding that queue without them.
+    dropStaleTop(ranked[entry.kind]);
+    auto byHost = rankedByHost[entry.kind].find(getURLServer(entry.url));
+    if (byHost != rankedByHost[entry.kind].end()) {
+      dropStaleTop(byHost->second);
+      if (byHost->second.empty()) rankedByHost[entry.kind].erase(byHost);
+    }
+    size_t numStale = ranked[entry.kind].size() - numPending[entry.kind];
+    if (numStale >= kMinStaleToRebuild && numStale > numPending[entry.kind]) rebuildRanked(entry.kind);
+    return true;
+  }
+  return false;
+}
+
+void CrawlFrontier::dropStaleTop(priority_queue<Ranked>& queue) {
+  while (!queue.empty()) {
+    auto top = pending.find(queue.top().url);
+    if (top != pending.end() && top->second.sequence == queue.top().sequence) return;
+    queue.pop();
+  }
+}
+
+void CrawlFrontier::rebuildRanked(Kind kind) {
+  vector<Ranked> live;
+  live.reserve(numPending[kind]);
+  for (const pair<const string, PendingEntry>& entry : pending) {
+    const Entry& e = entry.second.entry;
+    if (e.kind == kind) live.push_back({e.priority, entry.second.sequence, e.url});
+  }
+  ranked[kind] = priority_queue<Ranked>(less<Ranked>(), move(live));
+}
+
+void CrawlFrontier::complete(const string& url, Outcome outcome) {
+  lock_guard<mutex> lg(lock);
+  applyOutcome(url, outcome);
+  if (fd == -1) return;
+  uint8_t type = outcome == Succeeded ? kSucceeded : outcome == Failed ? kFailed : kSkipped;
+  appendRecord(fd, type, Feed, url, "", "", 0);
+  compact();
+}
+
+size_t CrawlFrontier::getNumPending(Kind kind) const {
+  lock_guard<mutex> lg(lock);
+  return numPending[kind];
+}
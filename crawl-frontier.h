@@ -0,0 +1,160 @@
+/**
+ * File: crawl-frontier.h
+ * ----------------------
+ * Defines the CrawlFrontier class, the priority queue of feed and article URLs
+ * waiting to be fetched.  The feed and article pools draw from it, so work is
+ * done in priority order rather than in whatever order the feed list or a
+ * feed happens to list it.  An entry's priority is the product of its
+ * importance, its freshness, and the health of its host (the smoothed fraction
+ * of its fetches that have succeeded).
+ *
+ * A frontier can be backed by a file, an append-only log of fixed-layout
+ * records: every push, every completed fetch, and every fetch outcome.  On
+ * open the log is mapped into memory and replayed, so a restart continues
+ * with whatever was still pending, in the same order, and host health carries
+ * over.  A torn record at the end (from a crash mid-append) is truncated
+ * away, and a log dominated by completed entries is compacted.
+ */
+
+#pragma once
+#include <cstdint>
+#include <ctime>
+#include <mutex>
+#include <queue>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+class CrawlFrontier {
+ public:
+  enum Kind { Feed = 0, Article = 1 };
+  enum Outcome { Skipped, Succeeded, Failed };
+
+/**
+ * Struct: Entry
+ * -------------
+ * One URL waiting to be fetched, along with the title it was listed
+ * under, its GUID (articles only, and possibly empty), and its priority.
+ */
+  struct Entry {
+    Kind kind;
+    std::string url;
+    std::string title;
+    std::string guid;
+    double priority;
+  };
+
+/**
+ * Destructor: ~CrawlFrontier
+ * --------------------------
+ * Closes the backing log, if there is one.
+ */
+  ~CrawlFrontier();
+
+/**
+ * Method: open
+ * ------------
+ * Backs the frontier with the log at the supplied path, creating it if need
+ * be and otherwise replaying it.  Returns false if the log couldn't be opened,
+ * in which case the frontier carries on in memory alone.
+ */
+  bool open(const std::string& path);
+
+/**
+ * Method: push
+ * ------------
+ * Adds the supplied URL to the frontier with priority importance * freshness
+ * * the health of its host.  Returns false (and does nothing) if the URL is
+ * already pending or being fetched.
+ */
+  bool push(Kind kind, const std::string& url, const std::string& title, const std::string& guid,
+            double importance, double freshness);
+
+/**
+ * Method: pop
+ * -----------
+ * Removes the highest-priority pending entry of the supplied kind and
+ * populates entry with it.  Returns false if there isn't one.  The entry
+ * stays in the log until complete is called, so a crash before then
+ * leaves it pending for the next run.
+ */
+  bool pop(Kind kind, Entry& entry);
+
+/**
+ * Method: pop
+ * -----------
+ * As above, but prefers the highest-priority pending entry from the supplied
+ * host, if there is one, over any higher-priority entries from other hosts.
+ */
+  bool pop(Kind kind, Entry& entry, const std::string& preferredHost);
+
+/**
+ * Method: complete
+ * ----------------
+ * Records that the supplied popped URL has been dealt with, and whether
+ * fetching it succeeded or failed (which updates its host's health) or
+ * wasn't attempted.
+ */
+  void complete(const std::string& url, Outcome outcome);
+
+/**
+ * Method: getNumPending
+ * ---------------------
+ * Returns the number of entries of the supplied kind waiting to be popped.
+ */
+  size_t getNumPending(Kind kind) const;
+
+/**
+ * Static Method: getFreshness
+ * ---------------------------
+ * Maps a publication time to a freshness between 0 and 1 that halves
+ * with every day of age.  Unknown times (0) get a middling score.
+ */
+  static double getFreshness(time_t published, time_t now);
+
+ private:
+  struct Ranked {
+    double priority;
+    uint64_t sequence; // Earlier pushes win ties.
+    std::string url;
+    bool operator<(const Ranked& other) const {
+      return priority < other.priority || (priority == other.priority && sequence > other.sequence);
+    }
+  };
+
+  struct HostHealth {
+    uint64_t numSucceeded = 0;
+    uint64_t numFailed = 0;
+  };
+
+  struct PendingEntry {
+    Entry entry;
+    uint64_t sequence; // Matches the Ranked element that's current for this URL.
+  };
+
+  struct Record;
+
+  mutable std::mutex lock;
+  std::unordered_map<std::string, PendingEntry> pending; // Keyed by URL.
+  std::unordered_map<std::string, Entry> inFlight; // Popped but not yet completed.
+  std::priority_queue<Ranked> ranked[2]; // One per kind; holds stale entries until they reach the top or it's rebuilt.
+  std::unordered_map<std::string, std::priority_queue<Ranked>> rankedByHost[2]; // The same, split up by host.
+  size_t numPending[2] = {0, 0};
+  std::unordered_map<std::string, HostHealth> hosts;
+  uint64_t nextSequence = 0;
+
+  std::string path;
+  int fd = -1;
+  size_t numRecords = 0;
+
+  double getHostHealth(const std::string& host) const;
+  void insertPending(const Entry& entry);
+  bool popFrom(std::priority_queue<Ranked>& queue, Entry& entry);
+  void dropStaleTop(std::priority_queue<Ranked>& queue);
+  void rebuildRanked(Kind kind);
+  void applyOutcome(const std::string& url, Outcome outcome);
+  bool appendRecord(int fd, uint8_t type, Kind kind, const std::string& url, const std::string& title,
+                    const std::string& guid, double priority);
+  size_t replay(const char *start, size_t length);
+  void compact();
+};
@@ -0,0 +1,175 @@
+/**
+ * File: epoch-reclaimer.cc
+ * ------------------------
+ * Presents the implementation of the EpochReclaimer class.
+ */
+
+#include "epoch-reclaimer.h"
+
+#include <utility>
+using namespace std;
+
+/**
+ * Struct: ThreadRecord
+ * --------------------
+ * One thread's announced epoch and retired batches.  Only the owning thread
+ * touches anything but state, which is odd (the epoch, shifted left, plus one)
+ * while the thread is pinned and zero otherwise.  Batch i holds what was
+ * retired during the most recent epoch congruent to i modulo kNumBatches.
+ */
+static const size_t kNumBatches = 3;
+struct alignas(64) EpochReclaimer::ThreadRecord {
+  atomic<uint64_t> state{0};
+  atomic<bool> inUse{true};
+  ThreadRecord *next = nullptr;
+  size_t depth = 0; // How many guards the thread holds.
+  size_t numPending = 0; // How many reclaims are waiting across all batches.
+  size_t numQuiescentStates = 0;
+  Batch batches[kNumBatches];
+};
+
+/**
+ * Struct: Registration
+ * --------------------
+ * Ties a record to the current thread, and hands the record back (with its
+ * unreclaimed batches orphaned) when the thread exits.
+ */
+struct EpochReclaimer::Registration {
+  ThreadRecord *record = nullptr;
+  ~Registration() {
+    if (record == nullptr) return;
+    EpochReclaimer& reclaimer = getInstance();
+    record->state.store(0, memory_order_release);
+    lock_guard<mutex> lg(reclaimer.orphansLock);
+    for (Batch& batch : record->batches) {
+      if (batch.reclaims.empty()) continue;
+      reclaimer.orphans.push_back(Batch());
+      swap(reclaimer.orphans.back(), batch);
+    }
+    reclaimer.numOrphans.store(reclaimer.orphans.size(), memory_order_relaxed);
+    record->numPending = 0;
+    record->inUse.store(false, memory_order_release);
+  }
+};
+
+EpochReclaimer& EpochReclaimer::getInstance() {
+  // Never destroyed, so threads exiting during shutdown can still orphan their batches.
+  static EpochReclaimer *instance = new EpochReclaimer();
+  return *instance;
+}
+
+EpochReclaimer::ThreadRecord& EpochReclaimer::getRecord() {
+  static thread_local Registration registration;
+  if (registration.record != nullptr) return *registration.record;
+
+  for (ThreadRecord *record = records.load(memory_order_acquire); record != nullptr; record = record->next) {
+    bool inUse = false;
+    if (record->inUse.compare_exchange_strong(inUse, true, memory_order_acquire)) {
+      registration.record = record;
+      return *record;
+    }
+  }
+  ThreadRecord *record = new ThreadRecord();
+  record->next = records.load(memory_order_relaxed);
+  while (!records.compare_exchange_weak(record->next, record, memory_order_release, memory_order_relaxed)) {}
+  registration.record = record;
+  return *record;
+}
+
+EpochReclaimer::Guard::Guard() {
+  EpochReclaimer& reclaimer = getInstance();
+  reclaimer.pin(reclaimer.getRecord());
+}
+
+EpochReclaimer::Guard::~Guard() {
+  EpochReclaimer& reclaimer = getInstance();
+  reclaimer.unpin(reclaimer.getRecord());
+}
+
+void EpochReclaimer::pin(ThreadRecord& record) {
+  if (record.depth++ > 0) return;
+  // The announcement must be visible before anything the guard protects is read,
+  // and must name the epoch that's current once it is.
+  uint64_t epoch;
+  do {
+    epoch = globalEpoch.load(memory_order_seq_cst);
+    record.state.store(epoch << 1 | 1, memory_order_seq_cst);
+  } while (globalEpoch.load(memory_order_seq_cst) != epoch);
+}
+
+void EpochReclaimer::unpin(ThreadRecord& record) {
+  if (--record.depth > 0) return;
+  record.state.store(0, memory_order_release);
+}
+
+bool EpochReclaimer::tryAdvance() {
+  uint64_t epoch = globalEpoch.load(memory_order_seq_cst);
+  for (ThreadRecord *record = records.load(memory_order_acquire); record != nullptr; record = record->next) {
+    uint64_t state = record->state.load(memory_order_seq_cst);
+    if ((state & 1) && (state >> 1) != epoch) return false;
+  }
+  return globalEpoch.compare_exchange_strong(epoch, epoch + 1, memory_order_seq_cst);
+}
+
+void EpochReclaimer::reclaimBatch(Batch& batch) {
+  // Reclaiming may retire more, so the batch is emptied before anything runs.
+  vector<function<void(void)>> reclaims;
+  reclaims.swap(batch.reclaims);
+  for (const function<void(void)>& reclaim : reclaims) reclaim();
+}
+
+static const size_t kMaxPendingBeforeCollecting = 64;
+void EpochReclaimer::retire(const function<void(void)>& reclaim) {
+  ThreadRecord& record = getRecord();
+  uint64_t epoch = globalEpoch.load(memory_order_seq_cst);
+  Batch& batch = record.batches[epoch % kNumBatches];
+  if (batch.epoch != epoch) {
+    // Whatever's still here is from kNumBatches or more epochs ago, so it's safe.
+    record.numPending -= batch.reclaims.size();
+    reclaimBatch(batch);
+    batch.epoch = epoch;
+  }
+  batch.reclaims.push_back(reclaim);
+  record.numPending++;
+  if (record.numPending >= kMaxPendingBeforeCollecting && record.depth == 0) {
+    tryAdvance();
+    collect(record);
+  }
+}
+
+void EpochReclaimer::collect(ThreadRecord& record) {
+  uint64_t epoch = globalEpoch.load(memory_order_seq_cst);
+  for (Batch& batch : record.batches) {
+    if (batch.reclaims.empty() || batch.epoch + 2 > epoch) continue;
+    record.numPending -= batch.reclaims.size();
+    reclaimBatch(batch);
+  }
+
+  vector<Batch> reclaimable;
+  if (!orphansLock.try_lock()) return; // Someone else is already on it.
+  for (size_t i = 0; i < orphans.size();) {
+    if (orphans[i].epoch + 2 > epoch) {
+      i++;
+      continue;
+    }
+    reclaimable.push_back(Batch());
+    swap(reclaimable.back(), orphans[i]);
+    swap(orphans[i], orphans.back());
+    orphans.pop_back();
+  }
+  numOrphans.store(orphans.size(), memory_order_relaxed);
+  orphansLock.unlock();
+  for (Batch& batch : reclaimable) reclaimBatch(batch);
+}
+
+static const size_t kQuiescentStatesPerAdvance = 32;
+void EpochReclaimer::quiescent() {
+  ThreadRecord& record = getRecord();
+  if (record.depth > 0) return;
+  // Threads with nothing to reclaim still advance the epoch now and then, so that others' batches become safe.
+  bool hasReclaims = record.numPending > 0 || numOrphans.load(memory_order_relaxed) > 0;
+  if (!hasReclaims && ++record.numQuiescentStates % kQuiescentStatesPerAdvance != 0) return;
+  // What was retired during the current epoch is safe two epochs on.
+  if (tryAdvance() && hasReclaims) tryAdvance();
+  collect(record);
+}
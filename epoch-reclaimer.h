@@ -0,0 +1,103 @@
+/**
+ * File: epoch-reclaimer.h
+ * -----------------------
+ * Defines the EpochReclaimer class, the one process-wide facility for freeing
+ * memory that other threads may still be reading without a lock: a snapshot
+ * that's just been replaced, say, or a node unlinked from a lock-free list.
+ * Rather than being freed on the spot, such memory is retired, and reclaimed
+ * only once every thread that might have seen it has moved on.
+ *
+ * Readers announce themselves by holding a Guard, which pins the thread to
+ * the current global epoch.  The epoch advances only once every pinned thread
+ * has caught up with it, so memory retired during one epoch is unreachable two
+ * epochs later.  Each thread batches what it retires by epoch and reclaims a
+ * batch as soon as it's safe, without any locking.  Threads that aren't pinned
+ * never hold the epoch back, however long they sleep; ThreadPool workers report
+ * a quiescent state between thunks, which is also when they advance the epoch
+ * and reclaim their own batches.  Other threads that retire memory should
+ * report one too, right after retiring it, since nothing else will reclaim
+ * their batches until they exit.
+ */
+
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <vector>
+
+class EpochReclaimer {
+ public:
+/**
+ * Static Method: getInstance
+ * --------------------------
+ * Returns the process-wide reclaimer, creating it the first time through.
+ */
+  static EpochReclaimer& getInstance();
+
+/**
+ * Class: Guard
+ * ------------
+ * Pins the constructing thread for the guard's lifetime, during which memory
+ * retired by any thread won't be reclaimed.  Guards may nest, but should be
+ * short-lived: a thread pinned for long stalls reclamation everywhere.
+ */
+  class Guard {
+   public:
+    Guard();
+    ~Guard();
+    Guard(const Guard& original) = delete;
+    Guard& operator=(const Guard& rhs) = delete;
+  };
+
+/**
+ * Method: retire
+ * --------------
+ * Arranges for the supplied function to be called once no guard that might
+ * have seen the memory it frees is still held.  The memory must already be
+ * unreachable to threads that pin from now on.  Safe to call from any thread.
+ */
+  void retire(const std::function<void(void)>& reclaim);
+
+/**
+ * Method: quiescent
+ * -----------------
+ * Reports that the calling thread holds no references to retired memory (it
+ * has no guard), and takes the chance to advance the epoch and reclaim what
+ * the thread has retired, along with what exited threads left behind.  If no
+ * other thread is pinned, everything retired so far is reclaimed before it
+ * returns.  Cheap enough to call between any two tasks.
+ */
+  void quiescent();
+
+ private:
+  struct ThreadRecord;
+  struct Registration;
+
+/**
+ * Private Type: Batch
+ * -------------------
+ * Everything a thread retired during one epoch.
+ */
+  struct Batch {
+    uint64_t epoch = 0;
+    std::vector<std::function<void(void)>> reclaims;
+  };
+
+  std::atomic<uint64_t> globalEpoch{0};
+  std::atomic<ThreadRecord *> records{nullptr}; // Never shrinks; records are reused once their threads exit.
+  std::mutex orphansLock;
+  std::vector<Batch> orphans; // Batches left behind by threads that exited before they were safe to reclaim.
+  std::atomic<size_t> numOrphans{0}; // orphans.size(), readable without the lock.
+
+  EpochReclaimer() {}
+  ThreadRecord& getRecord();
+  void pin(ThreadRecord& record);
+  void unpin(ThreadRecord& record);
+  bool tryAdvance();
+  void collect(ThreadRecord& record);
+  static void reclaimBatch(Batch& batch);
+
+  EpochReclaimer(const EpochReclaimer& original) = delete;
+  EpochReclaimer& operator=(const EpochReclaimer& rhs) = delete;
+};
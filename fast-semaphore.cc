@@ -0,0 +1,44 @@
+/**
+ * File: fast-semaphore.cc
+ * -----------------------
+ * Presents the implementation of the FastSemaphore class.
+ */
+
+#include "fast-semaphore.h"
+#include "futex.h"
+
+#include <thread>
+using namespace std;
+
+static const int kSpinsBeforeBlocking = 64;
+
+bool FastSemaphore::tryWait() {
+  int32_t current = count.load(memory_order_relaxed);
+  while (current > 0) {
+    if (count.compare_exchange_weak(current, current - 1, memory_order_acquire, memory_order_relaxed)) return true;
+  }
+  return false;
+}
+
+void FastSemaphore::wait() {
+  for (int spin = 0; spin < kSpinsBeforeBlocking; spin++) {
+    if (tryWait()) return;
+    this_thread::yield();
+  }
+  if (count.fetch_sub(1, memory_order_acquire) > 0) return;
+
+  // We're now counted as blocked, so the signal meant for us arrives as a wakeup.
+  while (true) {
+    uint32_t pending = wakeups.load(memory_order_relaxed);
+    while (pending > 0) {
+      if (wakeups.compare_exchange_weak(pending, pending - 1, memory_order_acquire, memory_order_relaxed)) return;
+    }
+    futexWait(wakeups, 0);
+  }
+}
+
+void FastSemaphore::signal() {
+  if (count.fetch_add(1, memory_order_release) >= 0) return;
+  wakeups.fetch_add(1, memory_order_release);
+  futexWake(wakeups); // Only the address is used, so it's fine if the waiter has already returned.
+}
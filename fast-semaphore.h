@@ -0,0 +1,57 @@
+/**
+ * File: fast-semaphore.h
+ * ----------------------
+ * Defines the FastSemaphore class, a drop-in replacement for semaphore that
+ * keeps its count in an atomic word.  Signaling, and waiting on a semaphore
+ * whose count is already positive, are a single atomic operation each; only
+ * a wait that has to block, or a signal with someone blocked to wake, makes a
+ * futex system call.  The ThreadPool's dispatcherEvents is signaled for
+ * every thunk queued and every worker gone idle, and the HttpFetcher waits
+ * on one per request.  See semaphore-ping-pong.cc for how the two compare.
+ *
+ * A signal touches nothing of the semaphore's once its waiter can return, so
+ * (as with the HttpFetcher's requests) the waiter may destroy it straight away.
+ */
+
+#pragma once
+#include <atomic>
+#include <cstdint>
+
+class FastSemaphore {
+ public:
+/**
+ * Constructor: FastSemaphore
+ * --------------------------
+ * Constructs a semaphore with the supplied (nonnegative) initial count.
+ */
+  FastSemaphore(int count = 0) : count(count) {}
+
+/**
+ * Method: wait
+ * ------------
+ * Blocks until the count is positive, then decrements it.  Spins briefly
+ * before sleeping, since the signal that's needed is often on its way.
+ */
+  void wait();
+
+/**
+ * Method: signal
+ * --------------
+ * Increments the count, waking one blocked waiter if there is one.
+ */
+  void signal();
+
+ private:
+  std::atomic<int32_t> count; // Negative when there are waiters blocked, by minus their number.
+  std::atomic<uint32_t> wakeups{0}; // Futex word: signals handed to blocked waiters but not yet taken.
+
+/**
+ * Method: tryWait
+ * ---------------
+ * Decrements the count and returns true if it's positive, without blocking.
+ */
+  bool tryWait();
+
+  FastSemaphore(const FastSemaphore& original) = delete;
+  FastSemaphore& operator=(const FastSemaphore& rhs) = delete;
+};
@@ -0,0 +1,177 @@
+/**
+ * File: feed-cache.cc
+ * -------------------
+ * Presents the implementation of the FeedCache class.
+ */
+
+#include "feed-cache.h"
+
+#include <libxml/xmlIO.h>
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+using namespace std;
+
+static const char kMagic[8] = {'R', 'S', 'S', 'F', 'C', 'C', 'H', '1'};
+
+namespace {
+/**
+ * Class: Reader
+ * -------------
+ * Pulls fixed-width values and length-prefixed strings off the front of a
+ * buffer, failing (for good) as soon as one would run past its end.
+ */
+class Reader {
+ public:
+  Reader(const char *start, const char *end) : next(start), end(end) {}
+
+  template <typename T>
+  bool read(T& value) {
+    if (size_t(end - next) < sizeof(value)) return fail();
+    memcpy(&value, next, sizeof(value));
+    next += sizeof(value);
+    return true;
+  }
+
+  bool read(string& value) {
+    uint32_t length;
+    if (!read(length) || size_t(end - next) < length) return fail();
+    value.assign(next, length);
+    next += length;
+    return true;
+  }
+
+  bool isDone() const { return !failed && next == end; }
+
+ private:
+  const char *next;
+  const char *end;
+  bool failed = false;
+
+  bool fail() {
+    next = end;
+    failed = true;
+    return false;
+  }
+};
+}
+
+template <typename T>
+static void write(string& buffer, const T& value) {
+  buffer.append(reinterpret_cast<const char *>(&value), sizeof(value));
+}
+
+static void write(string& buffer, const string& value) {
+  write(buffer, uint32_t(value.size()));
+  buffer += value;
+}
+
+static bool readItem(Reader& reader, FeedItem& item) {
+  int64_t published;
+  if (!reader.read(item.article.title) || !reader.read(item.article.url) || !reader.read(item.guid) ||
+      !reader.read(item.canonicalURL) || !reader.read(published)) {
+    return false;
+  }
+  item.published = published;
+  return true;
+}
+
+bool FeedCache::load(const string& path) {
+  lock_guard<mutex> lg(entriesLock);
+  entries.clear();
+  ifstream in(path, ios::binary);
+  if (!in) return true;
+  stringstream contents;
+  contents << in.rdbuf();
+  string buffer = contents.str();
+  if (buffer.size() < sizeof(kMagic) || memcmp(buffer.data(), kMagic, sizeof(kMagic)) != 0) return false;
+
+  Reader reader(buffer.data() + sizeof(kMagic), buffer.data() + buffer.size());
+  uint32_t numEntries;
+  if (!reader.read(numEntries)) return false;
+  for (uint32_t i = 0; i < numEntries; i++) {
+    string url;
+    Entry entry;
+    uint32_t numItems;
+    if (!reader.read(url) || !reader.read(entry.contentHash) || !reader.read(numItems)) break;
+    entry.items.reserve(min<size_t>(numItems, 1 << 16)); // a corrupt count mustn't allocate gigabytes up front
+    for (uint32_t j = 0; j < numItems; j++) {
+      entry.items.emplace_back();
+      if (!readItem(reader, entry.items.back())) break;
+    }
+    entries[url] = move(entry);
+  }
+  if (!reader.isDone()) {
+    entries.clear();
+    return false;
+  }
+  return true;
+}
+
+bool FeedCache::save(const string& path) const {
+  string buffer(kMagic, sizeof(kMagic));
+  lock_guard<mutex> lg(entriesLock);
+  uint32_t numUsed = 0;
+  write(buffer, numUsed); // patched below
+  for (const pair<const string, Entry>& entry : entries) {
+    if (!entry.second.used) continue;
+    numUsed++;
+    write(buffer, entry.first);
+    write(buffer, entry.second.contentHash);
+    write(buffer, uint32_t(entry.second.items.size()));
+    for (const FeedItem& item : entry.second.items) {
+      write(buffer, item.article.title);
+      write(buffer, item.article.url);
+      write(buffer, item.guid);
+      write(buffer, item.canonicalURL);
+      write(buffer, int64_t(item.published));
+    }
+  }
+  memcpy(&buffer[sizeof(kMagic)], &numUsed, sizeof(numUsed));
+
+  string temporaryPath = path + ".tmp";
+  ofstream out(temporaryPath, ios::binary | ios::trunc);
+  out.write(buffer.data(), buffer.size());
+  out.close();
+  if (!out) return false;
+  return rename(temporaryPath.c_str(), path.c_str()) == 0;
+}
+
+bool FeedCache::lookup(const string& url, uint64_t contentHash, vector<FeedItem>& items) {
+  lock_guard<mutex> lg(entriesLock);
+  unordered_map<string, Entry>::iterator found = entries.find(url);
+  if (found == entries.end() || found->second.contentHash != contentHash) return false;
+  found->second.used = true;
+  items = found->second.items;
+  return true;
+}
+
+void FeedCache::store(const string& url, uint64_t contentHash, const vector<FeedItem>& items) {
+  lock_guard<mutex> lg(entriesLock);
+  Entry& entry = entries[url];
+  entry.contentHash = contentHash;
+  entry.items = items;
+  entry.used = true;
+}
+
+uint64_t FeedCache::hashContent(const string& content) {
+  uint64_t hash = 14695981039346656037ULL;
+  for (char ch : content) {
+    hash ^= static_cast<unsigned char>(ch);
+    hash *= 1099511628211ULL;
+  }
+  return hash;
+}
+
+static const int kReadChunkSize = 16 * 1024;
+bool FeedCache::readContent(const string& url, string& content) {
+  xmlParserInputBufferPtr input = xmlParserInputBufferCreateFilename(url.c_str(), XML_CHAR_ENCODING_NONE);
+  if (input == NULL) return false;
+  int numRead;
+  while ((numRead = xmlParserInputBufferGrow(input, kReadChunkSize)) > 0);
+  if (numRead == 0) content.assign(reinterpret_cast<const char *>(xmlBufContent(input->buffer)), xmlBufUse(input->buffer));
+  xmlFreeParserInputBuffer(input);
+  return numRead == 0;
+}
@@ -0,0 +1,88 @@
+/**
+ * File: feed-cache.h
+ * ------------------
+ * Defines the FeedCache class, which remembers what the feed list and each
+ * feed parsed to, keyed by URL and a hash of the raw bytes they were parsed
+ * from.  Fetching a feed is unavoidable (there's no other way to learn
+ * whether it changed), but parsing an unchanged one with libxml isn't: on a
+ * restart, most feeds and the feed list itself come back byte for byte the
+ * same, and their items can be copied out of the cache instead.
+ *
+ * The cache is saved to a compact binary file: a magic number, then one
+ * record per URL holding its content hash and its items, every string
+ * length-prefixed so loading is a single pass of bounds checks and copies.
+ * Only the entries used during a run are saved, so feeds that drop out
+ * of the list drop out of the cache too.
+ */
+
+#pragma once
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "feed-document.h"
+
+class FeedCache {
+ public:
+/**
+ * Method: load
+ * ------------
+ * Replaces the cache's contents with those saved in the supplied file.  A
+ * missing file is simply an empty cache.  Returns false (leaving the cache
+ * empty) if the file can't be read or isn't a well-formed cache.
+ */
+  bool load(const std::string& path);
+
+/**
+ * Method: save
+ * ------------
+ * Writes every entry looked up or stored since the cache was loaded to the
+ * supplied file, replacing it atomically.  Returns false if it couldn't be written.
+ */
+  bool save(const std::string& path) const;
+
+/**
+ * Method: lookup
+ * --------------
+ * Populates items with what the supplied URL parsed to, and returns true,
+ * if it was last parsed from content with the supplied hash.  Returns false
+ * otherwise.  Safe to call from any thread.
+ */
+  bool lookup(const std::string& url, uint64_t contentHash, std::vector<FeedItem>& items);
+
+/**
+ * Method: store
+ * -------------
+ * Records what the supplied URL parsed to, replacing whatever was recorded
+ * for it before.  Safe to call from any thread.
+ */
+  void store(const std::string& url, uint64_t contentHash, const std::vector<FeedItem>& items);
+
+/**
+ * Static Method: hashContent
+ * --------------------------
+ * Returns the 64-bit FNV-1a hash of the supplied raw bytes.
+ */
+  static uint64_t hashContent(const std::string& content);
+
+/**
+ * Static Method: readContent
+ * --------------------------
+ * Reads the raw bytes at the supplied URL through libxml's input layer, so
+ * the same URLs (http, files, gzip) xmlReadFile accepts work here.  Returns
+ * false if they couldn't be read.
+ */
+  static bool readContent(const std::string& url, std::string& content);
+
+ private:
+  struct Entry {
+    uint64_t contentHash;
+    std::vector<FeedItem> items;
+    bool used = false;
+  };
+
+  mutable std::mutex entriesLock;
+  std::unordered_map<std::string, Entry> entries;
+};
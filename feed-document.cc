@@ -0,0 +1,237 @@
+/**
+ * File: feed-document.cc
+ * ----------------------
+ * Presents the implementation of the FeedDocument class.
+ */
+
+#include "feed-document.h"
+
+#include <libxml/parser.h>
+#include <libxml/tree.h>
+
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+
+#include "feed-cache.h"
+#include "rss-feed-exception.h"
+#include "string-utils.h"
+using namespace std;
+
+// Query parameters that only track where a click came from.
+static const char *const kTrackingParameterPrefixes[] = {"utm_", "fbclid", "gclid", "mc_cid", "mc_eid", "ocid", "cmpid"};
+
+static bool isTrackingParameter(const string& parameter) {
+  for (const char *prefix : kTrackingParameterPrefixes) {
+    if (parameter.compare(0, strlen(prefix), prefix) == 0) return true;
+  }
+  return false;
+}
+
+string canonicalizeURL(const string& url) {
+  string rest = trim(url);
+  size_t fragment = rest.find('#');
+  if (fragment != string::npos) rest.erase(fragment);
+
+  size_t schemeEnd = rest.find("://");
+  string scheme;
+  if (schemeEnd != string::npos) {
+    scheme = rest.substr(0, schemeEnd);
+    for (char& ch : scheme) ch = tolower(static_cast<unsigned char>(ch));
+    rest.erase(0, schemeEnd + 3);
+  }
+
+  size_t hostEnd = rest.find_first_of("/?");
+  string host = rest.substr(0, hostEnd);
+  string path = hostEnd == string::npos ? "" : rest.substr(hostEnd);
+  for (char& ch : host) ch = tolower(static_cast<unsigned char>(ch));
+  if ((scheme == "http" && host.size() > 3 && host.compare(host.size() - 3, 3, ":80") == 0) ||
+      (scheme == "https" && host.size() > 4 && host.compare(host.size() - 4, 4, ":443") == 0)) {
+    host.erase(host.rfind(':'));
+  }
+  if (host.compare(0, 4, "www.") == 0) host.erase(0, 4);
+
+  string query;
+  size_t queryStart = path.find('?');
+  if (queryStart != string::npos) {
+    string parameters = path.substr(queryStart + 1);
+    path.erase(queryStart);
+    size_t start = 0;
+    while (start <= parameters.size()) {
+      size_t end = parameters.find('&', start);
+      if (end == string::npos) end = parameters.size();
+      string parameter = parameters.substr(start, end - start);
+      if (!parameter.empty() && !isTrackingParameter(parameter)) {
+        query += query.empty() ? '?' : '&';
+        query += parameter;
+      }
+      start = end + 1;
+    }
+  }
+  while (!path.empty() && path.back() == '/') path.pop_back();
+  return host + path + query;
+}
+
+// Offsets of the zone names RFC 822 allows in place of a numeric offset.
+static const struct {
+  const char *name;
+  int hours;
+} kNamedZones[] = {
+  {"GMT", 0}, {"UT", 0}, {"UTC", 0}, {"Z", 0}, {"EST", -5}, {"EDT", -4},
+  {"CST", -6}, {"CDT", -5}, {"MST", -7}, {"MDT", -6}, {"PST", -8}, {"PDT", -7},
+};
+
+/**
+ * Function: parseZoneOffset
+ * -------------------------
+ * Parses a zone of the form +hhmm, +hh:mm or a name from kNamedZones into a
+ * number of seconds east of UTC.  Returns false if the zone isn't one of those.
+ */
+static bool parseZoneOffset(string zone, long& offset) {
+  zone = trim(zone);
+  if (zone.empty()) {
+    offset = 0;
+    return true;
+  }
+  if (zone[0] == '+' || zone[0] == '-') {
+    zone.erase(remove(zone.begin(), zone.end(), ':'), zone.end());
+    if (zone.size() != 5 || !all_of(zone.begin() + 1, zone.end(), ::isdigit)) return false;
+    offset = (stoi(zone.substr(1, 2)) * 60 + stoi(zone.substr(3, 2))) * 60;
+    if (zone[0] == '-') offset = -offset;
+    return true;
+  }
+  for (const auto& named : kNamedZones) {
+    if (zone == named.name) {
+      offset = named.hours * 3600;
+      return true;
+    }
+  }
+  return false;
+}
+
+/**
+ * Function: parseTimestamp
+ * ------------------------
+ * Parses an RSS (RFC 822) or Atom (RFC 3339) date into seconds since the
+ * epoch.  Returns 0 if the date is in neither form.
+ */
+static time_t parseTimestamp(const string& date) {
+  struct tm parsed;
+  memset(&parsed, 0, sizeof(parsed));
+  const char *rest = strptime(date.c_str(), "%Y-%m-%dT%H:%M:%S", &parsed);
+  if (rest != NULL) {
+    while (*rest == '.' || isdigit(static_cast<unsigned char>(*rest))) rest++; // fractional seconds
+  } else {
+    memset(&parsed, 0, sizeof(parsed));
+    const char *start = date.c_str();
+    const char *comma = strchr(start, ',');
+    if (comma != NULL) start = comma + 1; // the day of the week is optional
+    rest = strptime(start, " %d %b %Y %H:%M", &parsed);
+    if (rest == NULL) return 0;
+    if (*rest == ':') rest = strptime(rest, ":%S", &parsed);
+    if (rest == NULL) return 0;
+  }
+  long offset;
+  if (!parseZoneOffset(rest, offset)) return 0;
+  return timegm(&parsed) - offset;
+}
+
+FeedDocument::FeedDocument(const string& url) : url(url) {}
+
+static bool isNamed(const xmlNode *node, const char *name) {
+  return node->type == XML_ELEMENT_NODE && strcmp(reinterpret_cast<const char *>(node->name), name) == 0;
+}
+
+static string getText(const xmlNode *node) {
+  xmlChar *content = xmlNodeGetContent(node);
+  if (content == NULL) return "";
+  string text = trim(reinterpret_cast<const char *>(content));
+  xmlFree(content);
+  return text;
+}
+
+static string getAttribute(const xmlNode *node, const char *name) {
+  xmlChar *value = xmlGetProp(node, reinterpret_cast<const xmlChar *>(name));
+  if (value == NULL) return "";
+  string attribute = trim(reinterpret_cast<const char *>(value));
+  xmlFree(value);
+  return attribute;
+}
+
+/**
+ * Function: parseItem
+ * -------------------
+ * Extracts the title, link and GUID of an RSS <item> or Atom <entry>.  A
+ * FeedBurner origLink, when present, is preferred over the (redirecting) link.
+ */
+static FeedItem parseItem(const xmlNode *item) {
+  FeedItem parsed;
+  string origLink;
+  parsed.guid = getAttribute(item, "about"); // RSS 1.0
+  for (const xmlNode *child = item->children; child != NULL; child = child->next) {
+    if (isNamed(child, "title")) {
+      parsed.article.title = getText(child);
+    } else if (isNamed(child, "link")) {
+      // RSS puts the link in the element's text, Atom in its href.
+      string rel = getAttribute(child, "rel");
+      string href = getAttribute(child, "href");
+      if (href.empty()) href = getText(child);
+      if (!href.empty() && (rel.empty() || rel == "alternate") && parsed.article.url.empty())
+        parsed.article.url = href;
+    } else if (isNamed(child, "origLink")) {
+      origLink = getText(child);
+    } else if (isNamed(child, "guid") || isNamed(child, "id")) {
+      parsed.guid = getText(child);
+    } else if (isNamed(child, "pubDate") || isNamed(child, "published") || isNamed(child, "updated") ||
+               isNamed(child, "date")) {
+      // Atom's published date wins over its updated one; any date wins over none.
+      time_t published = parseTimestamp(getText(child));
+      if (published != 0 && (parsed.published == 0 || !isNamed(child, "updated"))) parsed.published = published;
+    }
+  }
+  if (!origLink.empty()) parsed.article.url = origLink;
+  parsed.canonicalURL = canonicalizeURL(parsed.article.url);
+  return parsed;
+}
+
+static void collectItems(const xmlNode *node, vector<FeedItem>& items) {
+  for (const xmlNode *child = node->children; child != NULL; child = child->next) {
+    if (child->type != XML_ELEMENT_NODE) continue;
+    if (isNamed(child, "item") || isNamed(child, "entry")) {
+      FeedItem item = parseItem(child);
+      if (!item.article.url.empty()) items.push_back(item);
+    } else {
+      collectItems(child, items);
+    }
+  }
+}
+
+static const int kParseOptions = XML_PARSE_RECOVER | XML_PARSE_NOERROR | XML_PARSE_NOWARNING | XML_PARSE_NOCDATA;
+/**
+ * Function: extractItems
+ * ----------------------
+ * Replaces items with those of the supplied document, then frees it.
+ */
+static void extractItems(xmlDocPtr doc, vector<FeedItem>& items) {
+  xmlNodePtr root = xmlDocGetRootElement(doc);
+  items.clear();
+  if (root != NULL) collectItems(root, items);
+  xmlFreeDoc(doc);
+}
+
+void FeedDocument::parse() {
+  xmlDocPtr doc = xmlReadFile(url.c_str(), NULL, kParseOptions);
+  if (doc == NULL) throw RSSFeedException("Unable to fetch or parse the feed at \"" + url + "\".");
+  extractItems(doc, items);
+}
+
+void FeedDocument::parse(FeedCache& cache) {
+  string content;
+  if (!FeedCache::readContent(url, content)) throw RSSFeedException("Unable to fetch the feed at \"" + url + "\".");
+  uint64_t contentHash = FeedCache::hashContent(content);
+  if (cache.lookup(url, contentHash, items)) return;
+  xmlDocPtr doc = xmlReadMemory(content.data(), content.size(), url.c_str(), NULL, kParseOptions);
+  if (doc == NULL) throw RSSFeedException("Unable to parse the feed at \"" + url + "\".");
+  extractItems(doc, items);
+  cache.store(url, contentHash, items);
+}
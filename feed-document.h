@@ -0,0 +1,77 @@
+/**
+ * File: feed-document.h
+ * ---------------------
+ * Defines the FeedDocument class, which downloads and parses an RSS 2.0,
+ * RSS 1.0 or Atom feed.  It does what RSSFeed does, but also keeps each item's
+ * GUID (an RSS <guid>, an Atom <id>, or an RSS 1.0 rdf:about) and a
+ * canonical form of its link.  Those let the aggregator recognize items it
+ * has already indexed before it spends a download on them.
+ */
+
+#pragma once
+#include <ctime>
+#include <string>
+#include <vector>
+
+#include "article.h"
+
+/**
+ * Struct: FeedItem
+ * ----------------
+ * One item of a feed: the article it links to, its GUID (empty if
+ * the feed didn't supply one), its canonical link, and when it was
+ * published (0 if the feed didn't say).
+ */
+struct FeedItem {
+  Article article;
+  std::string guid;
+  std::string canonicalURL;
+  time_t published = 0;
+};
+
+/**
+ * Function: canonicalizeURL
+ * -------------------------
+ * Returns the form of the supplied URL used to decide whether two links
+ * refer to the same article.  The scheme, a leading "www.", default
+ * ports, the fragment, tracking parameters (utm_*, fbclid and the like)
+ * and any trailing slash are all dropped, and the host is lowercased.
+ */
+std::string canonicalizeURL(const std::string& url);
+
+class FeedCache;
+
+class FeedDocument {
+ public:
+/**
+ * Constructor: FeedDocument
+ * -------------------------
+ * Constructs a feed around the supplied URL.  Nothing is fetched until parse is called.
+ */
+  FeedDocument(const std::string& url);
+
+/**
+ * Method: parse
+ * -------------
+ * Downloads and parses the feed, collecting its items.  Items without a
+ * link are dropped.  Throws an RSSFeedException if the feed can't be
+ * fetched or parsed.
+ */
+  void parse();
+
+/**
+ * Method: parse
+ * -------------
+ * As above, but skips the XML parse altogether if the supplied cache holds
+ * the items of a feed downloaded from this URL with exactly the same bytes,
+ * and records the items in the cache otherwise.
+ */
+  void parse(FeedCache& cache);
+
+  const std::string& getURL() const { return url; }
+  const std::vector<FeedItem>& getItems() const { return items; }
+
+ private:
+  std::string url;
+  std::vector<FeedItem> items;
+};
@@ -0,0 +1,115 @@
+/**
+ * File: feed-list-reader.cc
+ * -------------------------
+ * Presents the implementation of the FeedListReader class.
+ */
+
+#include "feed-list-reader.h"
+
+#include <libxml/tree.h>
+#include <libxml/xmlreader.h>
+
+#include <cstring>
+
+#include "feed-document.h"
+#include "rss-feed-list-exception.h"
+#include "string-utils.h"
+using namespace std;
+
+FeedListReader::FeedListReader(const string& url, FeedCache *cache) : url(url), cache(cache) {}
+
+static bool isNamed(const xmlNode *node, const char *name) {
+  return node->type == XML_ELEMENT_NODE && strcmp(reinterpret_cast<const char *>(node->name), name) == 0;
+}
+
+static string getText(const xmlNode *node) {
+  xmlChar *content = xmlNodeGetContent(node);
+  if (content == NULL) return "";
+  string text = trim(reinterpret_cast<const char *>(content));
+  xmlFree(content);
+  return text;
+}
+
+static uint64_t getFingerprint(const string& url) {
+  uint64_t hash = 14695981039346656037ULL; // FNV-1a
+  for (char ch : canonicalizeURL(url)) {
+    hash ^= static_cast<unsigned char>(ch);
+    hash *= 1099511628211ULL;
+  }
+  return hash;
+}
+
+/**
+ * Function: readItems
+ * -------------------
+ * Reads every <item> the supplied reader has left, calling onFeed for each
+ * one whose fingerprint is new (and appending it to feeds, unless that's
+ * NULL).  Populates status with the reader's last status, which is negative
+ * if the list turned out to be malformed, and returns the number of feeds.
+ */
+static size_t readItems(xmlTextReaderPtr reader, unordered_set<uint64_t>& fingerprints,
+                        const FeedListReader::FeedFunction& onFeed, vector<FeedItem> *feeds, int& status) {
+  size_t numFeeds = 0;
+  status = xmlTextReaderRead(reader);
+  while (status == 1) {
+    if (xmlTextReaderNodeType(reader) != XML_READER_TYPE_ELEMENT ||
+        strcmp(reinterpret_cast<const char *>(xmlTextReaderConstLocalName(reader)), "item") != 0) {
+      status = xmlTextReaderRead(reader);
+      continue;
+    }
+
+    // Only this item's subtree is built; the reader frees it once it moves past.
+    xmlNodePtr item = xmlTextReaderExpand(reader);
+    if (item == NULL) {
+      status = -1;
+      break;
+    }
+    string title, link;
+    for (const xmlNode *child = item->children; child != NULL; child = child->next) {
+      if (isNamed(child, "title")) title = getText(child);
+      else if (isNamed(child, "link") && link.empty()) link = getText(child);
+    }
+    if (!link.empty() && fingerprints.insert(getFingerprint(link)).second) {
+      onFeed(link, title);
+      if (feeds != NULL) {
+        feeds->emplace_back();
+        feeds->back().article.url = link;
+        feeds->back().article.title = title;
+      }
+      numFeeds++;
+    }
+    status = xmlTextReaderNext(reader);
+  }
+  return numFeeds;
+}
+
+static const int kParseOptions = XML_PARSE_RECOVER | XML_PARSE_NOERROR | XML_PARSE_NOWARNING | XML_PARSE_NOCDATA;
+size_t FeedListReader::read(const FeedFunction& onFeed) {
+  if (cache == NULL) {
+    xmlTextReaderPtr reader = xmlReaderForFile(url.c_str(), NULL, kParseOptions);
+    if (reader == NULL) throw RSSFeedListException("Unable to fetch the feed list at \"" + url + "\".");
+    int status;
+    size_t numFeeds = readItems(reader, fingerprints, onFeed, NULL, status);
+    xmlFreeTextReader(reader);
+    if (status < 0 && numFeeds == 0) throw RSSFeedListException("Unable to parse the feed list at \"" + url + "\".");
+    return numFeeds;
+  }
+
+  string content;
+  if (!FeedCache::readContent(url, content)) throw RSSFeedListException("Unable to fetch the feed list at \"" + url + "\".");
+  uint64_t contentHash = FeedCache::hashContent(content);
+  vector<FeedItem> feeds;
+  if (cache->lookup(url, contentHash, feeds)) {
+    for (const FeedItem& feed : feeds) onFeed(feed.article.url, feed.article.title); // deduplicated when stored
+    return feeds.size();
+  }
+
+  xmlTextReaderPtr reader = xmlReaderForMemory(content.data(), content.size(), url.c_str(), NULL, kParseOptions);
+  if (reader == NULL) throw RSSFeedListException("Unable to parse the feed list at \"" + url + "\".");
+  int status;
+  size_t numFeeds = readItems(reader, fingerprints, onFeed, &feeds, status);
+  xmlFreeTextReader(reader);
+  if (status < 0 && numFeeds == 0) throw RSSFeedListException("Unable to parse the feed list at \"" + url + "\".");
+  cache->store(url, contentHash, feeds);
+  return numFeeds;
+}
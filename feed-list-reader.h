@@ -0,0 +1,61 @@
+/**
+ * File: feed-list-reader.h
+ * ------------------------
+ * Defines the FeedListReader class, which streams the entries of a feed list
+ * to a callback as they're parsed.  RSSFeedList builds the whole list in
+ * memory before handing back the first feed, which for lists of a hundred
+ * thousand feeds means seconds in which no feed is being fetched.  This
+ * reader pulls the list through libxml's xmlTextReader, holding one entry's
+ * subtree at a time, so feeds can be fetched while the rest of the list is
+ * still arriving.
+ *
+ * Items are deduplicated as they go by a set of 64-bit fingerprints of
+ * their canonical URLs, which is far smaller than the URLs themselves.
+ *
+ * Given a FeedCache, the reader downloads the whole list first and replays
+ * the feeds it was last read to if its bytes haven't changed, skipping the
+ * parse altogether.
+ */
+
+#pragma once
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+#include "feed-cache.h"
+
+class FeedListReader {
+ public:
+/**
+ * Type: FeedFunction
+ * ------------------
+ * Called with the URL and title of each distinct feed in the list.
+ */
+  typedef std::function<void(const std::string& url, const std::string& title)> FeedFunction;
+
+/**
+ * Constructor: FeedListReader
+ * ---------------------------
+ * Constructs a reader around the supplied feed list URL, backed by the
+ * supplied cache unless it's NULL.
+ */
+  FeedListReader(const std::string& url, FeedCache *cache = NULL);
+
+/**
+ * Method: read
+ * ------------
+ * Reads the feed list, calling onFeed for each feed the first time its
+ * canonical URL appears, and returns the number of distinct feeds.  Throws
+ * an RSSFeedListException if the list can't be fetched, or is malformed
+ * before its first feed.  Should the list be cut short or malformed after
+ * that, the feeds before the damage are kept, just as a recovering parse would.
+ */
+  size_t read(const FeedFunction& onFeed);
+
+ private:
+  std::string url;
+  FeedCache *cache;
+  std::unordered_set<uint64_t> fingerprints;
+};
@@ -0,0 +1,128 @@
+/**
+ * File: feed-refresh-scheduler.cc
+ * -------------------------------
+ * Presents the implementation of the FeedRefreshScheduler class.
+ */
+
+#include "feed-refresh-scheduler.h"
+
+#include <algorithm>
+#include <cmath>
+using namespace std;
+using develop::ThreadPool;
+
+// Only this many of the most recent publication times inform the rate, so it tracks changes in pace.
+static const size_t kMaxPublishedTimes = 32;
+
+FeedRefreshScheduler::FeedRefreshScheduler(ThreadPool& pool, const Options& options, const RefreshFunction& refresh)
+  : pool(pool), options(options), refresh(refresh) {}
+
+static string getItemKey(const FeedItem& item) {
+  return item.guid.empty() ? item.canonicalURL : item.guid;
+}
+
+void FeedRefreshScheduler::observe(FeedState& state, const vector<FeedItem>& items, time_t now, bool isFirst) {
+  set<string> itemKeys;
+  bool changed = false;
+  for (const FeedItem& item : items) {
+    string key = getItemKey(item);
+    if (!state.itemKeys.count(key)) changed = true;
+    itemKeys.insert(key);
+    if (item.published != 0) state.publishedTimes.push_back(item.published);
+  }
+  state.itemKeys.swap(itemKeys);
+  if (changed && !isFirst) state.numChanges++;
+
+  vector<time_t>& times = state.publishedTimes;
+  sort(times.begin(), times.end(), greater<time_t>());
+  times.erase(unique(times.begin(), times.end()), times.end());
+  if (times.size() > kMaxPublishedTimes) times.resize(kMaxPublishedTimes);
+  state.lastPoll = now;
+}
+
+double FeedRefreshScheduler::estimateRate(const FeedState& state, time_t now) const {
+  const vector<time_t>& times = state.publishedTimes;
+  if (times.size() >= 2) {
+    // Every item after the oldest arrived somewhere in (oldest, now].
+    double span = difftime(max(now, times.front()), times.back());
+    if (span > 0) return (times.size() - 1) / span;
+  }
+  if (state.numPolls > 0 && state.totalInterval > 0) {
+    double n = state.numPolls, changes = state.numChanges;
+    return -log((n - changes + 0.5) / (n + 0.5)) / (state.totalInterval / n);
+  }
+  return 0;
+}
+
+double FeedRefreshScheduler::getPollInterval(double rate, double freshnessTarget) {
+  // Solves (1 - e^(-x)) / x = target for x = rate * interval by bisection; the left side falls from 1 toward 0.
+  auto freshness = [](double x) { return x == 0 ? 1 : -expm1(-x) / x; };
+  double low = 0, high = 1;
+  while (freshness(high) > freshnessTarget && high < 1e9) high *= 2;
+  for (int iteration = 0; iteration < 64; iteration++) {
+    double middle = (low + high) / 2;
+    if (freshness(middle) > freshnessTarget) low = middle;
+    else high = middle;
+  }
+  return low / rate;
+}
+
+chrono::seconds FeedRefreshScheduler::getNextInterval(const FeedState& state, time_t now) const {
+  double rate = estimateRate(state, now);
+  double interval;
+  if (rate > 0) {
+    interval = getPollInterval(rate, options.freshnessTarget);
+  } else if (state.numPolls > 0) {
+    // Nothing has changed yet, so back off from the average interval so far.
+    interval = 2 * state.totalInterval / state.numPolls;
+  } else {
+    interval = options.defaultInterval.count();
+  }
+  interval = min<double>(max<double>(interval, options.minInterval.count()), options.maxInterval.count());
+  return chrono::seconds(static_cast<long long>(interval));
+}
+
+void FeedRefreshScheduler::track(const string& feedURL, const vector<FeedItem>& items) {
+  lock_guard<mutex> lg(feedsLock);
+  observe(feeds[feedURL], items, time(NULL), true);
+}
+
+void FeedRefreshScheduler::start() {
+  lock_guard<mutex> lg(feedsLock);
+  time_t now = time(NULL);
+  for (const pair<const string, FeedState>& feed : feeds) {
+    scheduleNextPoll(feed.first, getNextInterval(feed.second, now));
+  }
+}
+
+void FeedRefreshScheduler::stop() {
+  lock_guard<mutex> lg(feedsLock);
+  stopped = true;
+}
+
+void FeedRefreshScheduler::scheduleNextPoll(const string& feedURL, chrono::seconds interval) {
+  pool.scheduleAfter(interval, [this, feedURL] { poll(feedURL); }, [this, feedURL] {
+    lock_guard<mutex> lg(feedsLock);
+    if (!stopped) scheduleNextPoll(feedURL, options.deferredInterval);
+  });
+}
+
+void FeedRefreshScheduler::poll(const string& feedURL) {
+  feedsLock.lock();
+  bool isStopped = stopped;
+  feedsLock.unlock();
+  if (isStopped) return;
+
+  vector<FeedItem> items;
+  bool fetched = refresh(feedURL, items);
+
+  lock_guard<mutex> lg(feedsLock);
+  if (stopped) return;
+  FeedState& state = feeds[feedURL];
+  time_t now = time(NULL);
+  state.numPolls++;
+  state.totalInterval += difftime(now, state.lastPoll);
+  if (fetched) observe(state, items, now, false);
+  else state.lastPoll = now;
+  scheduleNextPoll(feedURL, getNextInterval(state, now));
+}
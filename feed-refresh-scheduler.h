@@ -0,0 +1,124 @@
+/**
+ * File: feed-refresh-scheduler.h
+ * ------------------------------
+ * Defines the FeedRefreshScheduler class, which keeps polling feeds after the
+ * initial crawl, each at its own cadence.  Polling everything at one rate
+ * wastes most fetches on feeds that rarely change and lets fast ones go stale.
+ *
+ * Each feed is modelled as a Poisson process of new items.  Its rate is
+ * estimated from the publication times of its items when the feed supplies
+ * them (the k most recent items published over the span since the oldest of
+ * them), and otherwise from its change history, using the bias-reduced
+ * estimator -ln((n - X + 1/2) / (n + 1/2)) / I for X changes seen over n polls
+ * an average of I seconds apart.
+ *
+ * A feed polled every I seconds at rate r is, averaged over time, up to date
+ * a fraction (1 - e^(-rI)) / (rI) of the time.  That falls as I grows, so each
+ * feed's next poll is set as far out as the freshness target allows, which
+ * meets the target with the fewest fetches.  The polls themselves run on the
+ * ThreadPool's timer facility, at low priority: a poll the pool turns away
+ * because it's overloaded is put off, and tried again a little later.
+ */
+
+#pragma once
+#include <chrono>
+#include <ctime>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "feed-document.h"
+#include "thread-pool.h"
+
+class FeedRefreshScheduler {
+ public:
+/**
+ * Struct: Options
+ * ---------------
+ * The freshness target (the fraction of time each feed should be up to
+ * date) and the bounds on the interval between two polls of one feed.
+ */
+  struct Options {
+    double freshnessTarget = 0.9;
+    std::chrono::seconds minInterval{5 * 60};
+    std::chrono::seconds maxInterval{24 * 60 * 60};
+    std::chrono::seconds defaultInterval{60 * 60}; // Used until there's anything to estimate from.
+    std::chrono::seconds deferredInterval{60}; // How long a poll the pool turned away waits to try again.
+  };
+
+/**
+ * Type: RefreshFunction
+ * ---------------------
+ * Polls the named feed, indexing whatever is new, and populates items with
+ * everything the feed currently lists.  Returns false if the feed couldn't
+ * be fetched.
+ */
+  typedef std::function<bool(const std::string& feedURL, std::vector<FeedItem>& items)> RefreshFunction;
+
+/**
+ * Constructor: FeedRefreshScheduler
+ * ---------------------------------
+ * Constructs a scheduler that runs refresh on the supplied pool.
+ */
+  FeedRefreshScheduler(develop::ThreadPool& pool, const Options& options, const RefreshFunction& refresh);
+
+/**
+ * Method: track
+ * -------------
+ * Records the items the supplied feed listed when it was first fetched.
+ * Safe to call from any thread.
+ */
+  void track(const std::string& feedURL, const std::vector<FeedItem>& items);
+
+/**
+ * Method: start
+ * -------------
+ * Schedules the next poll of every tracked feed.
+ */
+  void start();
+
+/**
+ * Method: stop
+ * ------------
+ * Stops polling.  Polls already in progress finish, but none are scheduled
+ * after them, and timers that expire later do nothing.
+ */
+  void stop();
+
+/**
+ * Static Method: getPollInterval
+ * ------------------------------
+ * Returns the longest interval between polls that keeps a feed changing
+ * at the supplied rate (per second) up to date the target fraction of the time.
+ */
+  static double getPollInterval(double rate, double freshnessTarget);
+
+ private:
+  struct FeedState {
+    std::set<std::string> itemKeys; // The items listed by the last successful poll.
+    std::vector<time_t> publishedTimes; // The most recent publication times, newest first.
+    time_t lastPoll = 0;
+    size_t numPolls = 0; // Polls since the first, successful or not.
+    size_t numChanges = 0; // Polls that found at least one new item.
+    double totalInterval = 0; // Seconds between consecutive polls, summed.
+  };
+
+  develop::ThreadPool& pool;
+  Options options;
+  RefreshFunction refresh;
+  std::mutex feedsLock;
+  std::map<std::string, FeedState> feeds;
+  bool stopped = false;
+
+  void observe(FeedState& state, const std::vector<FeedItem>& items, time_t now, bool isFirst);
+  double estimateRate(const FeedState& state, time_t now) const;
+  std::chrono::seconds getNextInterval(const FeedState& state, time_t now) const;
+  void scheduleNextPoll(const std::string& feedURL, std::chrono::seconds interval);
+  void poll(const std::string& feedURL);
+
+  FeedRefreshScheduler(const FeedRefreshScheduler& original) = delete;
+  FeedRefreshScheduler& operator=(const FeedRefreshScheduler& rhs) = delete;
+};
@@ -0,0 +1,36 @@
+/**
+ * File: futex.h
+ * -------------
+ * Thin wrappers around the Linux futex system call, for the few places
+ * (the ThreadPool's mailboxes and the FastSemaphore) that keep their
+ * state in an atomic word and only need the kernel to sleep or wake on it.
+ * Both are process-private, which lets the kernel skip the shared-mapping lookup.
+ */
+
+#pragma once
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <cstdint>
+
+/**
+ * Function: futexWait
+ * -------------------
+ * Sleeps until woken, provided the supplied word still holds the expected
+ * value; returns at once otherwise.  May also return spuriously, so callers
+ * must recheck whatever condition they were waiting on.
+ */
+inline void futexWait(std::atomic<uint32_t>& word, uint32_t expected) {
+  syscall(SYS_futex, reinterpret_cast<uint32_t *>(&word), FUTEX_WAIT_PRIVATE, expected, NULL, NULL, 0);
+}
+
+/**
+ * Function: futexWake
+ * -------------------
+ * Wakes up to the supplied number of threads sleeping on the supplied word.
+ */
+inline void futexWake(std::atomic<uint32_t>& word, int numWaiters = 1) {
+  syscall(SYS_futex, reinterpret_cast<uint32_t *>(&word), FUTEX_WAKE_PRIVATE, numWaiters, NULL, NULL, 0);
+}
@@ -0,0 +1,182 @@
+/**
+ * File: http-fetcher.cc
+ * ---------------------
+ * Presents the implementation of the HttpFetcher class.
+ */
+
+#include "http-fetcher.h"
+#include "tls-session-cache.h"
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+#include "text-normalization.h"
+using namespace std;
+
+static const long kMaxRedirects = 5;
+static const int kPollTimeoutMS = 1000;
+
+/**
+ * Struct: Request
+ * ---------------
+ * One request, owned by the thread blocked in fetch until finished is signaled.
+ */
+struct HttpFetcher::Request {
+  CURL *easy;
+  Limits limits;
+  string body;
+  bool sniffed = false; // Whether the first bytes of the body have been checked.
+  bool truncated = false;
+  CURLcode result = CURLE_OK;
+  FastSemaphore finished;
+};
+
+// Content types that hold (or may hold) markup or text.
+static const char *const kTextTypes[] = {"text/", "application/xhtml", "application/xml", "application/rss",
+                                         "application/atom"};
+
+static bool isTextType(const char *contentType) {
+  for (const char *prefix : kTextTypes) {
+    if (strncasecmp(contentType, prefix, strlen(prefix)) == 0) return true;
+  }
+  return false;
+}
+
+/**
+ * Method: receiveBody
+ * -------------------
+ * libcurl's write callback.  Returning anything short of the chunk's length
+ * stops the transfer (and resets just its stream, when multiplexing).
+ */
+size_t HttpFetcher::receiveBody(char *data, size_t size, size_t count, void *userdata) {
+  Request *request = static_cast<Request *>(userdata);
+  size_t length = size * count;
+  if (!request->sniffed && length > 0) {
+    request->sniffed = true;
+    if (request->limits.textOnly) {
+      // By the time the body starts, the headers (of the final response, after any redirects) are in.
+      char *contentType = NULL;
+      curl_easy_getinfo(request->easy, CURLINFO_CONTENT_TYPE, &contentType);
+      if ((contentType != NULL && !isTextType(contentType)) || looksBinary(data, length)) return 0;
+    }
+  }
+  size_t maxBytes = request->limits.maxBytes;
+  if (maxBytes > 0 && request->body.size() + length > maxBytes) {
+    request->body.append(data, maxBytes - request->body.size());
+    request->truncated = true;
+    return 0;
+  }
+  request->body.append(data, length);
+  return length;
+}
+
+static once_flag curlInitialized;
+
+HttpFetcher::HttpFetcher(const Options& options) : options(options) {
+  call_once(curlInitialized, [] { curl_global_init(CURL_GLOBAL_DEFAULT); });
+  multi = curl_multi_init();
+  curl_multi_setopt(multi, CURLMOPT_PIPELINING, options.multiplex ? CURLPIPE_MULTIPLEX : CURLPIPE_NOTHING);
+  curl_multi_setopt(multi, CURLMOPT_MAX_HOST_CONNECTIONS, options.maxConnectionsPerHost);
+  curl_multi_setopt(multi, CURLMOPT_MAX_CONCURRENT_STREAMS, options.maxStreamsPerConnection);
+  loopThread = thread([this] { runLoop(); });
+}
+
+HttpFetcher::~HttpFetcher() {
+  submittedLock.lock();
+  exiting = true;
+  submittedLock.unlock();
+  curl_multi_wakeup(multi);
+  loopThread.join();
+  curl_multi_cleanup(multi);
+}
+
+bool HttpFetcher::canFetch(const string& url) {
+  return url.compare(0, 7, "http://") == 0 || url.compare(0, 8, "https://") == 0;
+}
+
+bool HttpFetcher::fetch(const string& url, string& body, const Limits& limits) {
+  Request request;
+  request.limits = limits;
+  request.easy = curl_easy_init();
+  if (request.easy == NULL) return false;
+  curl_easy_setopt(request.easy, CURLOPT_URL, url.c_str());
+  curl_easy_setopt(request.easy, CURLOPT_PRIVATE, &request);
+  curl_easy_setopt(request.easy, CURLOPT_WRITEFUNCTION, receiveBody);
+  curl_easy_setopt(request.easy, CURLOPT_WRITEDATA, &request);
+  curl_easy_setopt(request.easy, CURLOPT_FOLLOWLOCATION, 1L);
+  curl_easy_setopt(request.easy, CURLOPT_MAXREDIRS, kMaxRedirects);
+  curl_easy_setopt(request.easy, CURLOPT_ACCEPT_ENCODING, ""); // whatever libcurl can decode
+  curl_easy_setopt(request.easy, CURLOPT_TIMEOUT, options.timeoutSeconds);
+  curl_easy_setopt(request.easy, CURLOPT_NOSIGNAL, 1L);
+  if (options.resumeTLSSessions) TLSSessionCache::getInstance().attach(request.easy);
+  if (options.multiplex && url.compare(0, 8, "https://") == 0) {
+    // ALPN settles whether a connection multiplexes as soon as it's up, so waiting for it costs little.
+    curl_easy_setopt(request.easy, CURLOPT_PIPEWAIT, 1L);
+    curl_easy_setopt(request.easy, CURLOPT_HTTP_VERSION, CURL_HTTP_VERSION_2TLS);
+  } else if (options.multiplex) {
+    // Asks to upgrade, staying on HTTP/1.1 if the server declines.  That isn't known until the
+    // first response, so other requests don't wait on it.
+    curl_easy_setopt(request.easy, CURLOPT_HTTP_VERSION, CURL_HTTP_VERSION_2_0);
+  } else {
+    curl_easy_setopt(request.easy, CURLOPT_HTTP_VERSION, CURL_HTTP_VERSION_1_1);
+  }
+
+  submittedLock.lock();
+  if (exiting) {
+    submittedLock.unlock();
+    curl_easy_cleanup(request.easy);
+    return false;
+  }
+  submitted.push_back(&request);
+  submittedLock.unlock();
+  curl_multi_wakeup(multi);
+  request.finished.wait();
+
+  long status = 0, numConnects = 0;
+  curl_easy_getinfo(request.easy, CURLINFO_RESPONSE_CODE, &status);
+  curl_easy_getinfo(request.easy, CURLINFO_NUM_CONNECTS, &numConnects);
+  numConnections.fetch_add(numConnects, memory_order_relaxed);
+  curl_easy_cleanup(request.easy);
+  bool complete = request.result == CURLE_OK || (request.result == CURLE_WRITE_ERROR && request.truncated);
+  if (!complete || status >= 400) return false;
+  body.swap(request.body);
+  return true;
+}
+
+void HttpFetcher::runLoop() {
+  vector<Request *> active;
+  while (true) {
+    submittedLock.lock();
+    bool isExiting = exiting;
+    deque<Request *> adopted;
+    adopted.swap(submitted);
+    submittedLock.unlock();
+    for (Request *request : adopted) {
+      curl_multi_add_handle(multi, request->easy);
+      active.push_back(request);
+    }
+    if (isExiting) break;
+
+    int numRunning;
+    curl_multi_perform(multi, &numRunning);
+    CURLMsg *message;
+    int numQueued;
+    while ((message = curl_multi_info_read(multi, &numQueued)) != NULL) {
+      if (message->msg != CURLMSG_DONE) continue;
+      Request *request;
+      curl_easy_getinfo(message->easy_handle, CURLINFO_PRIVATE, &request);
+      request->result = message->data.result;
+      curl_multi_remove_handle(multi, request->easy);
+      active.erase(find(active.begin(), active.end(), request));
+      request->finished.signal();
+    }
+    curl_multi_poll(multi, NULL, 0, kPollTimeoutMS, NULL);
+  }
+
+  for (Request *request : active) {
+    curl_multi_remove_handle(multi, request->easy);
+    request->result = CURLE_ABORTED_BY_CALLBACK;
+    request->finished.signal();
+  }
+}
@@ -0,0 +1,128 @@
+/**
+ * File: http-fetcher.h
+ * --------------------
+ * Defines the HttpFetcher class, which downloads many documents concurrently
+ * over HTTP/2, multiplexing every request to a host onto a single connection.
+ * Without it, every in-flight article download holds a connection (and a TLS
+ * handshake) of its own, and feed-heavy hosts serve hundreds of articles a crawl.
+ *
+ * All transfers are driven by one event loop thread over a libcurl multi
+ * handle.  Callers on any thread hand their requests to that loop and block
+ * until their response arrives, so the article pool's workers share the
+ * loop's connections instead of each opening one.  New requests to a host
+ * wait for its existing connection to confirm it can multiplex instead of
+ * racing to open a second, and open connections of their own only if it
+ * can't, so hosts that speak only HTTP/1.1 aren't held to one connection
+ * at a time.  The loop bounds the number of concurrent streams
+ * per connection, and libcurl's HTTP/2 session handles per-stream flow control
+ * windows.
+ *
+ * https URLs negotiate HTTP/2 through ALPN and fall back to HTTP/1.1 if the
+ * server doesn't offer it.  Plain http URLs ask to upgrade to HTTP/2 (h2c),
+ * and carry on over HTTP/1.1 if the server ignores the request, as most do.
+ *
+ * Every fetcher resumes TLS sessions through the process-wide
+ * TLSSessionCache, so the connections it does have to open (after a server
+ * closes an idle one, say, or all of them when not multiplexing) skip the
+ * full handshake to any host seen before.
+ */
+
+#pragma once
+#include <curl/curl.h>
+
+#include <atomic>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "fast-semaphore.h"
+
+class HttpFetcher {
+ public:
+/**
+ * Struct: Options
+ * ---------------
+ * Connection and stream limits, and how long any one request may take.
+ * Without multiplexing, every request speaks HTTP/1.1 over a connection
+ * of its own (reused once it's done); a limit of zero means no limit.
+ */
+  struct Options {
+    bool multiplex = true;
+    bool resumeTLSSessions = true;
+    long maxConnectionsPerHost = 0; // Multiplexed requests share one connection regardless.
+    long maxStreamsPerConnection = 100;
+    long timeoutSeconds = 30;
+  };
+
+/**
+ * Struct: Limits
+ * --------------
+ * What a single response may be.  A body longer than maxBytes is truncated
+ * to its first maxBytes bytes (zero means no limit), and the transfer
+ * stopped right there.  If textOnly is set, a response whose Content-Type
+ * or first bytes say it isn't text is abandoned before any more of it is read.
+ */
+  struct Limits {
+    size_t maxBytes = 0;
+    bool textOnly = false;
+  };
+
+/**
+ * Constructor: HttpFetcher
+ * ------------------------
+ * Starts the event loop.  Must first be called while only one thread is
+ * running, since it may initialize libcurl.
+ */
+  HttpFetcher(const Options& options);
+
+/**
+ * Destructor: ~HttpFetcher
+ * ------------------------
+ * Fails any requests still in flight, stops the event loop and closes every connection.
+ */
+  ~HttpFetcher();
+
+/**
+ * Method: fetch
+ * -------------
+ * Downloads the document at the supplied http or https URL, following
+ * redirects, and populates body with it (truncated as the limits say).
+ * Blocks until the response has arrived.  Returns false if the request
+ * failed, the server responded with an error status, or the response broke
+ * the limits in a way truncation can't fix.  Safe to call from any thread.
+ */
+  bool fetch(const std::string& url, std::string& body, const Limits& limits);
+
+/**
+ * Method: getNumConnections
+ * -------------------------
+ * Returns the number of connections opened (as opposed to reused) by the
+ * requests completed so far.
+ */
+  size_t getNumConnections() const { return numConnections.load(std::memory_order_relaxed); }
+
+/**
+ * Static Method: canFetch
+ * -----------------------
+ * Returns true if the supplied URL is one fetch handles (http or https).
+ */
+  static bool canFetch(const std::string& url);
+
+ private:
+  struct Request;
+
+  Options options;
+  CURLM *multi;
+  std::thread loopThread;
+  std::mutex submittedLock;
+  std::deque<Request *> submitted; // Handed over by fetch, not yet added to the multi handle.
+  bool exiting = false;
+  std::atomic<size_t> numConnections{0};
+
+  void runLoop();
+  static size_t receiveBody(char *data, size_t size, size_t count, void *userdata);
+
+  HttpFetcher(const HttpFetcher& original) = delete;
+  HttpFetcher& operator=(const HttpFetcher& rhs) = delete;
+};
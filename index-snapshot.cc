@@ -0,0 +1,584 @@
+/**
+ * File: index-snapshot.cc
+ * -----------------------
+ * Presents the implementation of the IndexSnapshot class.
+ */
+
+#include "index-snapshot.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <numeric>
+
+#include "sorted-intersection.h"
+#include "utils.h"
+using namespace std;
+
+static const char kImageMagic[8] = {'R', 'S', 'S', 'S', 'N', 'A', 'P', '3'};
+
+// Images this small are cheaper to populate in full at map time than to warm selectively.
+static const size_t kPopulateThreshold = 16 << 20;
+
+struct IndexSnapshot::Header {
+  char magic[8];
+  uint64_t generation;
+  uint64_t numTerms;
+  uint64_t numPostings;
+  uint64_t numArticles;
+  uint64_t termBytesSize;
+  uint64_t articleBytesSize;
+  uint64_t numServers;
+  uint64_t serverBytesSize;
+  uint64_t imageSize;
+};
+
+namespace {
+struct Layout {
+  size_t termOffsets;
+  size_t termBytes;
+  size_t postingsOffsets;
+  size_t postings;
+  size_t docIDs;
+  size_t docCounts;
+  size_t articleOffsets;
+  size_t articleBytes;
+  size_t serverOffsets;
+  size_t serverBytes;
+  size_t serverArticleOffsets;
+  size_t serverArticles;
+  size_t imageSize;
+};
+}
+
+static size_t align8(size_t offset) {
+  return (offset + 7) & ~size_t(7);
+}
+
+static Layout computeLayout(size_t headerSize, size_t numTerms, size_t numPostings, size_t numArticles,
+                            size_t termBytesSize, size_t articleBytesSize, size_t numServers, size_t serverBytesSize) {
+  Layout layout;
+  size_t offset = align8(headerSize);
+  layout.termOffsets = offset;
+  offset += (numTerms + 1) * sizeof(uint64_t);
+  layout.termBytes = offset;
+  offset = align8(offset + termBytesSize);
+  layout.postingsOffsets = offset;
+  offset += (numTerms + 1) * sizeof(uint64_t);
+  layout.postings = offset;
+  offset += numPostings * sizeof(IndexSnapshot::Posting);
+  layout.docIDs = offset;
+  offset = align8(offset + numPostings * sizeof(uint32_t));
+  layout.docCounts = offset;
+  offset = align8(offset + numPostings * sizeof(int32_t));
+  layout.articleOffsets = offset;
+  offset += (2 * numArticles + 1) * sizeof(uint64_t);
+  layout.articleBytes = offset;
+  offset = align8(offset + articleBytesSize);
+  layout.serverOffsets = offset;
+  offset += (numServers + 1) * sizeof(uint64_t);
+  layout.serverBytes = offset;
+  offset = align8(offset + serverBytesSize);
+  layout.serverArticleOffsets = offset;
+  offset += (numServers + 1) * sizeof(uint64_t);
+  layout.serverArticles = offset;
+  layout.imageSize = align8(offset + numArticles * sizeof(uint32_t));
+  return layout;
+}
+
+/**
+ * Function: getServerKey
+ * ----------------------
+ * Returns the name the server column files the supplied URL (or a bare
+ * server name) under: its server, lowercased, less any leading "www.".
+ */
+static string getServerKey(const string& url) {
+  string server = url.find("://") == string::npos ? url : getURLServer(url);
+  for (char& ch : server) ch = tolower(static_cast<unsigned char>(ch));
+  if (server.compare(0, 4, "www.") == 0) server.erase(0, 4);
+  return server;
+}
+
+/**
+ * Function: findString
+ * --------------------
+ * Binary searches a sorted table of count strings stored back to back in
+ * bytes, string i occupying [offsets[i], offsets[i + 1]).
+ */
+static bool findString(const uint64_t *offsets, const char *bytes, size_t count, const string& key, uint32_t& index) {
+  size_t low = 0, high = count;
+  while (low < high) {
+    size_t mid = (low + high) / 2;
+    size_t length = offsets[mid + 1] - offsets[mid];
+    int cmp = memcmp(bytes + offsets[mid], key.data(), min(length, key.size()));
+    if (cmp == 0) cmp = length < key.size() ? -1 : (length > key.size() ? 1 : 0);
+    if (cmp == 0) {
+      index = mid;
+      return true;
+    }
+    if (cmp < 0) low = mid + 1;
+    else high = mid;
+  }
+  return false;
+}
+
+// Ranked order: highest count first, then lowest article ID.
+static bool ranksBefore(const IndexSnapshot::Posting& one, const IndexSnapshot::Posting& two) {
+  return one.count > two.count || (one.count == two.count && one.articleID < two.articleID);
+}
+
+IndexSnapshot::IndexSnapshot(uint64_t generation, const vector<string>& terms,
+                             vector<vector<Posting>>& postingsByToken, const vector<Article>& articles) {
+  vector<uint32_t> articleOrder(articles.size());
+  iota(articleOrder.begin(), articleOrder.end(), 0);
+  sort(articleOrder.begin(), articleOrder.end(), [&articles](uint32_t one, uint32_t two) {
+    return articles[one] < articles[two];
+  });
+  vector<uint32_t> renumbered(articles.size());
+  for (uint32_t rank = 0; rank < articleOrder.size(); rank++) renumbered[articleOrder[rank]] = rank;
+
+  vector<uint32_t> termOrder;
+  size_t numPostings = 0, termBytesSize = 0, articleBytesSize = 0;
+  for (uint32_t id = 0; id < postingsByToken.size() && id < terms.size(); id++) {
+    if (postingsByToken[id].empty()) continue;
+    termOrder.push_back(id);
+    numPostings += postingsByToken[id].size();
+    termBytesSize += terms[id].size();
+  }
+  sort(termOrder.begin(), termOrder.end(), [&terms](uint32_t one, uint32_t two) { return terms[one] < terms[two]; });
+  for (const Article& article : articles) articleBytesSize += article.url.size() + article.title.size();
+
+  // Visiting articles in rank order leaves each server's list of IDs sorted.
+  map<string, vector<uint32_t>> articlesByServer;
+  for (uint32_t rank = 0; rank < articleOrder.size(); rank++) {
+    articlesByServer[getServerKey(articles[articleOrder[rank]].url)].push_back(rank);
+  }
+  size_t serverBytesSize = 0;
+  for (const pair<const string, vector<uint32_t>>& server : articlesByServer) serverBytesSize += server.first.size();
+
+  Layout layout = computeLayout(sizeof(Header), termOrder.size(), numPostings, articles.size(),
+                                termBytesSize, articleBytesSize, articlesByServer.size(), serverBytesSize);
+  ownedImage.assign(layout.imageSize / sizeof(uint64_t), 0);
+  char *base = reinterpret_cast<char *>(ownedImage.data());
+
+  Header *mutableHeader = reinterpret_cast<Header *>(base);
+  memcpy(mutableHeader->magic, kImageMagic, sizeof(kImageMagic));
+  mutableHeader->generation = generation;
+  mutableHeader->numTerms = termOrder.size();
+  mutableHeader->numPostings = numPostings;
+  mutableHeader->numArticles = articles.size();
+  mutableHeader->termBytesSize = termBytesSize;
+  mutableHeader->articleBytesSize = articleBytesSize;
+  mutableHeader->numServers = articlesByServer.size();
+  mutableHeader->serverBytesSize = serverBytesSize;
+  mutableHeader->imageSize = layout.imageSize;
+
+  uint64_t *termOffsetsOut = reinterpret_cast<uint64_t *>(base + layout.termOffsets);
+  uint64_t *postingsOffsetsOut = reinterpret_cast<uint64_t *>(base + layout.postingsOffsets);
+  Posting *postingsOut = reinterpret_cast<Posting *>(base + layout.postings);
+  uint32_t *docIDsOut = reinterpret_cast<uint32_t *>(base + layout.docIDs);
+  int32_t *docCountsOut = reinterpret_cast<int32_t *>(base + layout.docCounts);
+  char *termBytesOut = base + layout.termBytes;
+  size_t termCursor = 0, postingsCursor = 0;
+  for (size_t i = 0; i < termOrder.size(); i++) {
+    const string& term = terms[termOrder[i]];
+    termOffsetsOut[i] = termCursor;
+    memcpy(termBytesOut + termCursor, term.data(), term.size());
+    termCursor += term.size();
+
+    vector<Posting>& run = postingsByToken[termOrder[i]];
+    for (Posting& posting : run) posting.articleID = renumbered[posting.articleID];
+    sort(run.begin(), run.end(), [](const Posting& one, const Posting& two) { return one.articleID < two.articleID; });
+    for (size_t k = 0; k < run.size(); k++) {
+      docIDsOut[postingsCursor + k] = run[k].articleID;
+      docCountsOut[postingsCursor + k] = run[k].count;
+    }
+    sort(run.begin(), run.end(), ranksBefore);
+    postingsOffsetsOut[i] = postingsCursor;
+    memcpy(postingsOut + postingsCursor, run.data(), run.size() * sizeof(Posting));
+    postingsCursor += run.size();
+  }
+  termOffsetsOut[termOrder.size()] = termCursor;
+  postingsOffsetsOut[termOrder.size()] = postingsCursor;
+
+  uint64_t *articleOffsetsOut = reinterpret_cast<uint64_t *>(base + layout.articleOffsets);
+  char *articleBytesOut = base + layout.articleBytes;
+  size_t articleCursor = 0;
+  for (uint32_t rank = 0; rank < articleOrder.size(); rank++) {
+    const Article& article = articles[articleOrder[rank]];
+    articleOffsetsOut[2 * rank] = articleCursor;
+    memcpy(articleBytesOut + articleCursor, article.url.data(), article.url.size());
+    articleCursor += article.url.size();
+    articleOffsetsOut[2 * rank + 1] = articleCursor;
+    memcpy(articleBytesOut + articleCursor, article.title.data(), article.title.size());
+    articleCursor += article.title.size();
+  }
+  articleOffsetsOut[2 * articleOrder.size()] = articleCursor;
+
+  uint64_t *serverOffsetsOut = reinterpret_cast<uint64_t *>(base + layout.serverOffsets);
+  char *serverBytesOut = base + layout.serverBytes;
+  uint64_t *serverArticleOffsetsOut = reinterpret_cast<uint64_t *>(base + layout.serverArticleOffsets);
+  uint32_t *serverArticlesOut = reinterpret_cast<uint32_t *>(base + layout.serverArticles);
+  size_t serverIndex = 0, serverCursor = 0, serverArticleCursor = 0;
+  for (const pair<const string, vector<uint32_t>>& server : articlesByServer) {
+    serverOffsetsOut[serverIndex] = serverCursor;
+    memcpy(serverBytesOut + serverCursor, server.first.data(), server.first.size());
+    serverCursor += server.first.size();
+    serverArticleOffsetsOut[serverIndex] = serverArticleCursor;
+    memcpy(serverArticlesOut + serverArticleCursor, server.second.data(), server.second.size() * sizeof(uint32_t));
+    serverArticleCursor += server.second.size();
+    serverIndex++;
+  }
+  serverOffsetsOut[serverIndex] = serverCursor;
+  serverArticleOffsetsOut[serverIndex] = serverArticleCursor;
+
+  image = base;
+  imageSize = layout.imageSize;
+  bindSections();
+}
+
+IndexSnapshot::~IndexSnapshot() {
+  if (mapped) munmap(const_cast<char *>(image), imageSize);
+}
+
+bool IndexSnapshot::bindSections() {
+  if (imageSize < sizeof(Header)) return false;
+  header = reinterpret_cast<const Header *>(image);
+  if (memcmp(header->magic, kImageMagic, sizeof(kImageMagic)) != 0) return false;
+  if (header->imageSize != imageSize) return false;
+  Layout layout = computeLayout(sizeof(Header), header->numTerms, header->numPostings, header->numArticles,
+                                header->termBytesSize, header->articleBytesSize, header->numServers,
+                                header->serverBytesSize);
+  if (layout.imageSize != imageSize) return false;
+
+  termOffsets = reinterpret_cast<const uint64_t *>(image + layout.termOffsets);
+  termBytes = image + layout.termBytes;
+  postingsOffsets = reinterpret_cast<const uint64_t *>(image + layout.postingsOffsets);
+  postings = reinterpret_cast<const Posting *>(image + layout.postings);
+  docIDs = reinterpret_cast<const uint32_t *>(image + layout.docIDs);
+  docCounts = reinterpret_cast<const int32_t *>(image + layout.docCounts);
+  articleOffsets = reinterpret_cast<const uint64_t *>(image + layout.articleOffsets);
+  articleBytes = image + layout.articleBytes;
+  serverOffsets = reinterpret_cast<const uint64_t *>(image + layout.serverOffsets);
+  serverBytes = image + layout.serverBytes;
+  serverArticleOffsets = reinterpret_cast<const uint64_t *>(image + layout.serverArticleOffsets);
+  serverArticles = reinterpret_cast<const uint32_t *>(image + layout.serverArticles);
+
+  // Spot-check the final offset of each table; anything else would take a full scan.
+  return termOffsets[header->numTerms] == header->termBytesSize &&
+         postingsOffsets[header->numTerms] == header->numPostings &&
+         articleOffsets[2 * header->numArticles] == header->articleBytesSize &&
+         serverOffsets[header->numServers] == header->serverBytesSize &&
+         serverArticleOffsets[header->numServers] == header->numArticles;
+}
+
+shared_ptr<const IndexSnapshot> IndexSnapshot::load(const string& path) {
+  int fd = open(path.c_str(), O_RDONLY);
+  if (fd == -1) return nullptr;
+  struct stat st;
+  if (fstat(fd, &st) == -1 || st.st_size < (off_t) sizeof(Header)) {
+    close(fd);
+    return nullptr;
+  }
+  int flags = MAP_PRIVATE;
+  if ((size_t) st.st_size <= kPopulateThreshold) flags |= MAP_POPULATE;
+  void *region = mmap(NULL, st.st_size, PROT_READ, flags, fd, 0);
+  close(fd);
+  if (region == MAP_FAILED) return nullptr;
+
+  shared_ptr<IndexSnapshot> snapshot(new IndexSnapshot());
+  snapshot->image = static_cast<const char *>(region);
+  snapshot->imageSize = st.st_size;
+  snapshot->mapped = true;
+  if (!snapshot->bindSections()) return nullptr;
+  return snapshot;
+}
+
+bool IndexSnapshot::save(const string& path) const {
+  ofstream out(path, ios::binary | ios::trunc);
+  if (!out) return false;
+  out.write(image, imageSize);
+  return bool(out);
+}
+
+uint64_t IndexSnapshot::getGeneration() const {
+  return header->generation;
+}
+
+size_t IndexSnapshot::getNumArticles() const {
+  return header->numArticles;
+}
+
+size_t IndexSnapshot::numTerms() const {
+  return header->numTerms;
+}
+
+Article IndexSnapshot::getArticle(uint32_t articleID) const {
+  const uint64_t *offsets = articleOffsets + 2 * articleID;
+  Article article;
+  article.url.assign(articleBytes + offsets[0], offsets[1] - offsets[0]);
+  article.title.assign(articleBytes + offsets[1], offsets[2] - offsets[1]);
+  return article;
+}
+
+vector<pair<Article, vector<TokenCount>>> IndexSnapshot::exportArticles(TokenDictionary& dictionary) const {
+  vector<pair<Article, vector<TokenCount>>> exported(getNumArticles());
+  for (uint32_t articleID = 0; articleID < exported.size(); articleID++) exported[articleID].first = getArticle(articleID);
+  for (uint32_t termIndex = 0; termIndex < numTerms(); termIndex++) {
+    string term(termBytes + termOffsets[termIndex], termOffsets[termIndex + 1] - termOffsets[termIndex]);
+    TokenID id = dictionary.intern(term);
+    for (uint64_t k = postingsOffsets[termIndex]; k < postingsOffsets[termIndex + 1]; k++) {
+      exported[docIDs[k]].second.push_back({id, docCounts[k]});
+    }
+  }
+  for (pair<Article, vector<TokenCount>>& article : exported) {
+    sort(article.second.begin(), article.second.end(),
+         [](const TokenCount& one, const TokenCount& two) { return one.id < two.id; });
+  }
+  return exported;
+}
+
+bool IndexSnapshot::findTerm(const string& term, uint32_t& termIndex) const {
+  return findString(termOffsets, termBytes, numTerms(), term, termIndex);
+}
+
+bool IndexSnapshot::findServer(const string& server, uint32_t& serverIndex) const {
+  return findString(serverOffsets, serverBytes, header->numServers, getServerKey(server), serverIndex);
+}
+
+bool IndexSnapshot::hasServer(const string& server) const {
+  uint32_t serverIndex;
+  return findServer(server, serverIndex);
+}
+
+vector<uint32_t> IndexSnapshot::getMostFrequentTerms(size_t limit) const {
+  vector<uint32_t> terms(numTerms());
+  iota(terms.begin(), terms.end(), 0);
+  limit = min(limit, terms.size());
+  auto length = [this](uint32_t term) { return postingsOffsets[term + 1] - postingsOffsets[term]; };
+  partial_sort(terms.begin(), terms.begin() + limit, terms.end(),
+               [&length](uint32_t one, uint32_t two) { return length(one) > length(two); });
+  terms.resize(limit);
+  return terms;
+}
+
+IndexSnapshot::Region IndexSnapshot::getDictionaryRegion() const {
+  const char *start = reinterpret_cast<const char *>(termOffsets);
+  return {start, size_t(termBytes + header->termBytesSize - start)};
+}
+
+vector<IndexSnapshot::Region> IndexSnapshot::getPostingsRegions(uint32_t termIndex) const {
+  uint64_t begin = postingsOffsets[termIndex], length = postingsOffsets[termIndex + 1] - begin;
+  return {
+    {reinterpret_cast<const char *>(postings + begin), size_t(length * sizeof(Posting))},
+    {reinterpret_cast<const char *>(docIDs + begin), size_t(length * sizeof(uint32_t))},
+    {reinterpret_cast<const char *>(docCounts + begin), size_t(length * sizeof(int32_t))},
+  };
+}
+
+IndexSnapshot::Region IndexSnapshot::getArticleRegion() const {
+  // The server column follows the article table and is read alongside it, so it comes along.
+  const char *start = reinterpret_cast<const char *>(articleOffsets);
+  return {start, size_t(image + imageSize - start)};
+}
+
+void IndexSnapshot::fillPage(uint32_t termIndex, size_t start, size_t limit, ResultPage& page) const {
+  size_t begin = postingsOffsets[termIndex], end = postingsOffsets[termIndex + 1];
+  page.totalMatches = end - begin;
+  page.matches.clear();
+  size_t stop = min(end, begin + start + limit);
+  for (size_t i = begin + start; i < stop; i++) {
+    page.matches.push_back(make_pair(getArticle(postings[i].articleID), int(postings[i].count)));
+  }
+  page.hasMore = stop < end;
+  if (page.hasMore) {
+    page.next.generation = getGeneration();
+    page.next.termIndices.assign(1, termIndex);
+    page.next.serverIndex = ResultCursor::kNoServer;
+    page.next.lastCount = postings[stop - 1].count;
+    page.next.lastArticleID = postings[stop - 1].articleID;
+    page.next.numShown = stop - begin;
+  }
+}
+
+IndexSnapshot::ResultPage IndexSnapshot::getPage(const string& term, size_t limit) const {
+  ResultPage page;
+  uint32_t termIndex;
+  if (findTerm(term, termIndex)) fillPage(termIndex, 0, limit, page);
+  return page;
+}
+
+bool IndexSnapshot::resumePage(const ResultCursor& cursor, size_t limit, ResultPage& page) const {
+  if (cursor.generation != getGeneration() || cursor.termIndices.empty()) return false;
+  for (uint32_t termIndex : cursor.termIndices) {
+    if (termIndex >= numTerms()) return false;
+  }
+  if (cursor.serverIndex != ResultCursor::kNoServer && cursor.serverIndex >= header->numServers) return false;
+  Posting last = {cursor.lastArticleID, cursor.lastCount};
+  if (cursor.termIndices.size() > 1 || cursor.serverIndex != ResultCursor::kNoServer) {
+    fillConjunctivePage(cursor.termIndices, cursor.serverIndex, &last, cursor.numShown, limit, page);
+    return true;
+  }
+
+  uint32_t termIndex = cursor.termIndices[0];
+  const Posting *begin = postings + postingsOffsets[termIndex];
+  const Posting *end = postings + postingsOffsets[termIndex + 1];
+  const Posting *resume = upper_bound(begin, end, last, ranksBefore);
+  fillPage(termIndex, resume - begin, limit, page);
+  page.firstRank = cursor.numShown + 1;
+  if (page.hasMore) page.next.numShown = cursor.numShown + page.matches.size();
+  return true;
+}
+
+namespace {
+struct SortedList {
+  const uint32_t *ids;
+  const int32_t *counts; // NULL for the server column, which contributes nothing to the score.
+  size_t length;
+};
+}
+
+IndexSnapshot::ResultPage IndexSnapshot::getConjunctivePage(const vector<string>& terms, size_t limit,
+                                                            const string& server) const {
+  ResultPage page;
+  vector<uint32_t> termIndices;
+  for (const string& term : terms) {
+    uint32_t termIndex;
+    if (!findTerm(term, termIndex)) return page;
+    termIndices.push_back(termIndex);
+  }
+  if (termIndices.empty()) return page;
+  uint32_t serverIndex = ResultCursor::kNoServer;
+  if (!server.empty() && !findServer(server, serverIndex)) return page;
+  fillConjunctivePage(termIndices, serverIndex, NULL, 0, limit, page);
+  return page;
+}
+
+vector<IndexSnapshot::Posting> IndexSnapshot::intersectTerms(const vector<uint32_t>& termIndices,
+                                                             uint32_t serverIndex) const {
+  vector<SortedList> lists;
+  for (uint32_t termIndex : termIndices) {
+    uint64_t start = postingsOffsets[termIndex];
+    lists.push_back({docIDs + start, docCounts + start, postingsOffsets[termIndex + 1] - start});
+  }
+  if (serverIndex != ResultCursor::kNoServer) {
+    uint64_t start = serverArticleOffsets[serverIndex];
+    lists.push_back({serverArticles + start, NULL, serverArticleOffsets[serverIndex + 1] - start});
+  }
+
+  // Shortest lists first, so every intersection is as small as it can be.
+  sort(lists.begin(), lists.end(), [](const SortedList& one, const SortedList& two) { return one.length < two.length; });
+
+  vector<uint32_t> ids(lists[0].ids, lists[0].ids + lists[0].length);
+  vector<int32_t> counts(ids.size(), 0);
+  if (lists[0].counts != NULL) counts.assign(lists[0].counts, lists[0].counts + lists[0].length);
+  vector<uint32_t> idPositions(ids.size()), listPositions(ids.size());
+  for (size_t t = 1; t < lists.size() && !ids.empty(); t++) {
+    const SortedList& list = lists[t];
+    size_t numCommon = intersectSortedPositions(ids.data(), ids.size(), list.ids, list.length,
+                                                idPositions.data(), listPositions.data());
+    for (size_t k = 0; k < numCommon; k++) {
+      ids[k] = ids[idPositions[k]];
+      counts[k] = counts[idPositions[k]] + (list.counts == NULL ? 0 : list.counts[listPositions[k]]);
+    }
+    ids.resize(numCommon);
+    counts.resize(numCommon);
+  }
+
+  vector<Posting> matches(ids.size());
+  for (size_t k = 0; k < ids.size(); k++) matches[k] = {ids[k], counts[k]};
+  return matches;
+}
+
+static const size_t kNumRankedQueries = 8;
+shared_ptr<const vector<IndexSnapshot::Posting>> IndexSnapshot::findRankedMatches(const vector<uint32_t>& termIndices,
+                                                                                  uint32_t serverIndex) const {
+  {
+    lock_guard<mutex> lg(rankedMatchesLock);
+    for (list<RankedMatches>::iterator entry = rankedMatches.begin(); entry != rankedMatches.end(); ++entry) {
+      if (entry->termIndices != termIndices || entry->serverIndex != serverIndex) continue;
+      rankedMatches.splice(rankedMatches.begin(), rankedMatches, entry);
+      return entry->matches;
+    }
+  }
+
+  // Ranked without the lock, so other queries aren't held up.  Should two threads rank the
+  // same query at once, both cache it, and the extra copy simply ages out.
+  vector<Posting> matches = intersectTerms(termIndices, serverIndex);
+  sort(matches.begin(), matches.end(), ranksBefore);
+  shared_ptr<const vector<Posting>> ranked = make_shared<const vector<Posting>>(move(matches));
+  lock_guard<mutex> lg(rankedMatchesLock);
+  rankedMatches.push_front({termIndices, serverIndex, ranked});
+  if (rankedMatches.size() > kNumRankedQueries) rankedMatches.pop_back();
+  return ranked;
+}
+
+void IndexSnapshot::fillConjunctivePage(const vector<uint32_t>& termIndices, uint32_t serverIndex, const Posting *last,
+                                        size_t numShown, size_t limit, ResultPage& page) const {
+  // Most queries never go past their first page, so it ranks only the matches it shows.
+  // Later pages rank every match once, and resume in the cached ranking after the last one shown.
+  vector<Posting> firstMatches;
+  shared_ptr<const vector<Posting>> ranked;
+  const Posting *begin, *end;
+  if (last == NULL) {
+    firstMatches = intersectTerms(termIndices, serverIndex);
+    partial_sort(firstMatches.begin(), firstMatches.begin() + min(limit, firstMatches.size()), firstMatches.end(),
+                 ranksBefore);
+    begin = firstMatches.data();
+    end = begin + firstMatches.size();
+    page.totalMatches = firstMatches.size();
+  } else {
+    ranked = findRankedMatches(termIndices, serverIndex);
+    end = ranked->data() + ranked->size();
+    begin = upper_bound(ranked->data(), end, *last, ranksBefore);
+    page.totalMatches = ranked->size();
+  }
+
+  size_t numToShow = min(limit, size_t(end - begin));
+  page.matches.clear();
+  for (size_t k = 0; k < numToShow; k++) {
+    page.matches.push_back(make_pair(getArticle(begin[k].articleID), int(begin[k].count)));
+  }
+  page.firstRank = numShown + 1;
+  page.hasMore = numToShow < size_t(end - begin) && termIndices.size() <= ResultCursor::kMaxTerms;
+  if (page.hasMore) {
+    page.next.generation = getGeneration();
+    page.next.termIndices = termIndices;
+    page.next.serverIndex = serverIndex;
+    page.next.lastCount = begin[numToShow - 1].count;
+    page.next.lastArticleID = begin[numToShow - 1].articleID;
+    page.next.numShown = numShown + numToShow;
+  }
+}
+
+IndexStats IndexSnapshot::computeStats() const {
+  IndexStats stats;
+  stats.numArticles = header->numArticles;
+  stats.vocabularySize = numTerms();
+  stats.numPostings = header->numPostings;
+  stats.dictionaryBytes = getDictionaryRegion().length;
+  stats.postingsBytes = (numTerms() + 1) * sizeof(uint64_t) +
+                        header->numPostings * (sizeof(Posting) + sizeof(uint32_t) + sizeof(int32_t));
+  stats.articleTableBytes = getArticleRegion().length;
+
+  uint32_t halfArticles = header->numArticles / 2;
+  vector<size_t> lengths(numTerms());
+  for (size_t term = 0; term < numTerms(); term++) {
+    lengths[term] = postingsOffsets[term + 1] - postingsOffsets[term];
+    bool inFirstHalf = false;
+    for (size_t i = postingsOffsets[term]; i < postingsOffsets[term + 1]; i++) {
+      stats.numOccurrences += postings[i].count;
+      if (postings[i].articleID < halfArticles) inFirstHalf = true;
+    }
+    if (inFirstHalf) stats.halfVocabularySize++;
+  }
+  stats.summarizePostingsLengths(lengths);
+  return stats;
+}
@@ -0,0 +1,234 @@
+/**
+ * File: index-snapshot.h
+ * ----------------------
+ * Defines the IndexSnapshot class, an immutable, read-optimized copy of a
+ * ConcurrentRSSIndex.  Everything lives in flat arrays: the terms in sorted
+ * order (so a lookup is a binary search), one contiguous run of postings per
+ * term already ranked from highest to lowest count, and the article table in
+ * article order (so article IDs break ties exactly the way RSSIndex does).
+ *
+ * Because each posting list is stored in rank order, a page of results is a
+ * slice of it, and a ResultCursor can resume the next page with a binary
+ * search for the last match shown followed by k sequential reads.
+ *
+ * Each term's postings are also kept in article ID order, as parallel arrays
+ * of IDs and counts, so that multi-term queries can intersect them with the
+ * SIMD kernels in sorted-intersection.h.  Their ranking has to be computed,
+ * so the first cursor resumed for a query ranks all of its matches once and
+ * keeps them in a small cache, and later pages are a binary search and k
+ * reads of that, just as for a single term.
+ *
+ * A server column records which articles came from each server (as
+ * getURLServer names it), again as a sorted list of article IDs, so that a
+ * query restricted to one site intersects that list with the terms' lists
+ * like any other.  When the site is small, the intersection gallops past
+ * everything else in the terms' lists rather than reading it.
+ *
+ * The arrays are laid out back to back in a single position-independent
+ * image, so a snapshot can be saved to disk verbatim and later loaded with
+ * mmap instead of being rebuilt.  The dictionary sits at the front of the
+ * image, followed by the postings, the article table and the server column.
+ */
+
+#pragma once
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "article.h"
+#include "index-stats.h"
+#include "result-cursor.h"
+#include "token-dictionary.h"
+
+class IndexSnapshot {
+ public:
+  struct Posting {
+    uint32_t articleID;
+    int32_t count;
+  };
+
+/**
+ * Struct: ResultPage
+ * ------------------
+ * One page of ranked matches, the total number of matches for the term,
+ * and, when more remain, the cursor that resumes after this page.
+ */
+  struct ResultPage {
+    std::vector<std::pair<Article, int>> matches;
+    size_t totalMatches = 0;
+    size_t firstRank = 1;
+    bool hasMore = false;
+    ResultCursor next;
+  };
+
+/**
+ * Struct: Region
+ * --------------
+ * A contiguous byte range within the snapshot's image.
+ */
+  struct Region {
+    const char *start;
+    size_t length;
+  };
+
+/**
+ * Constructor: IndexSnapshot
+ * --------------------------
+ * Assembles a snapshot from the pieces a ConcurrentRSSIndex hands over: the
+ * term for every token ID, each token's postings, and the article table the
+ * postings refer to.  The generation distinguishes this snapshot's cursors
+ * from those of any other.
+ */
+  IndexSnapshot(uint64_t generation, const std::vector<std::string>& terms,
+                std::vector<std::vector<Posting>>& postingsByToken, const std::vector<Article>& articles);
+
+/**
+ * Destructor: ~IndexSnapshot
+ * --------------------------
+ * Unmaps the image if the snapshot was loaded from disk.
+ */
+  ~IndexSnapshot();
+
+/**
+ * Static Method: load
+ * -------------------
+ * Maps a snapshot previously written by save.  Nothing is read up front,
+ * so pages fault in as queries touch them unless warmed first.  Returns
+ * nullptr if the file can't be mapped or isn't a valid snapshot image.
+ */
+  static std::shared_ptr<const IndexSnapshot> load(const std::string& path);
+
+/**
+ * Method: save
+ * ------------
+ * Writes the snapshot's image to the supplied path.  Returns false on failure.
+ */
+  bool save(const std::string& path) const;
+
+/**
+ * Method: getPage
+ * ---------------
+ * Returns the first page of at most limit matches for the supplied
+ * (already normalized) term.  An unknown term produces an empty page.
+ */
+  ResultPage getPage(const std::string& term, size_t limit) const;
+
+/**
+ * Method: resumePage
+ * ------------------
+ * Populates page with the at most limit matches that follow the supplied
+ * cursor.  Returns false if the cursor belongs to some other snapshot or
+ * doesn't make sense for this one.
+ */
+  bool resumePage(const ResultCursor& cursor, size_t limit, ResultPage& page) const;
+
+/**
+ * Method: getConjunctivePage
+ * --------------------------
+ * Returns the top limit articles containing every one of the supplied
+ * (already normalized) terms, ranked by their combined counts.  If a server
+ * is supplied, only articles from that server are considered.  The page's
+ * cursor resumes with the next matches, just as getPage's does.
+ */
+  ResultPage getConjunctivePage(const std::vector<std::string>& terms, size_t limit,
+                                const std::string& server = "") const;
+
+/**
+ * Method: hasServer
+ * -----------------
+ * Returns true if any article in the snapshot came from the supplied server.
+ */
+  bool hasServer(const std::string& server) const;
+
+/**
+ * Method: computeStats
+ * --------------------
+ * Computes the same statistics ConcurrentRSSIndex::computeStats does,
+ * in one pass over the flat arrays and without taking any locks.
+ */
+  IndexStats computeStats() const;
+
+/**
+ * Method: exportArticles
+ * ----------------------
+ * Reconstructs every article along with the counts of the terms it
+ * contains, interning each term through the supplied dictionary, so that
+ * an index can be seeded with the snapshot's contents and extended.
+ * Each article's counts come out sorted by token ID.
+ */
+  std::vector<std::pair<Article, std::vector<TokenCount>>> exportArticles(TokenDictionary& dictionary) const;
+
+/**
+ * Methods: findTerm, getMostFrequentTerms
+ * ---------------------------------------
+ * Map a term to its position in the dictionary, and list the positions of
+ * the terms with the longest posting lists, longest first.
+ */
+  bool findTerm(const std::string& term, uint32_t& termIndex) const;
+  std::vector<uint32_t> getMostFrequentTerms(size_t limit) const;
+
+/**
+ * Methods: getDictionaryRegion, getPostingsRegions, getArticleRegion
+ * ------------------------------------------------------------------
+ * Expose where each part of the image lives, so that it can be prefaulted.
+ * A term's postings span three regions: its rank-ordered postings, which
+ * single-term pages read, and the ID-ordered article IDs and counts that
+ * conjunctive queries intersect.
+ */
+  Region getDictionaryRegion() const;
+  std::vector<Region> getPostingsRegions(uint32_t termIndex) const;
+  Region getArticleRegion() const;
+
+  uint64_t getGeneration() const;
+  size_t getNumArticles() const;
+  bool isMapped() const { return mapped; }
+
+ private:
+  struct Header;
+
+  std::vector<uint64_t> ownedImage; // Backs the image when the snapshot was built in memory.
+  const char *image = nullptr;
+  size_t imageSize = 0;
+  bool mapped = false;
+
+  const Header *header = nullptr;
+  const uint64_t *termOffsets = nullptr; // Term i occupies termBytes[termOffsets[i], termOffsets[i + 1]).
+  const char *termBytes = nullptr; // Every term, back to back, in sorted order.
+  const uint64_t *postingsOffsets = nullptr; // Term i's postings occupy postings[postingsOffsets[i], postingsOffsets[i + 1]).
+  const Posting *postings = nullptr; // Each term's run is ranked by count, then article ID.
+  const uint32_t *docIDs = nullptr; // Each term's article IDs in increasing order, parallel to docCounts.
+  const int32_t *docCounts = nullptr;
+  const uint64_t *articleOffsets = nullptr; // Article i's url and title are strings 2i and 2i + 1 of articleBytes.
+  const char *articleBytes = nullptr; // Sorted, so article IDs follow article order.
+  const uint64_t *serverOffsets = nullptr; // Server i's name occupies serverBytes[serverOffsets[i], serverOffsets[i + 1]).
+  const char *serverBytes = nullptr; // Every server name, back to back, in sorted order.
+  const uint64_t *serverArticleOffsets = nullptr; // Server i's articles occupy serverArticles[serverArticleOffsets[i], ...).
+  const uint32_t *serverArticles = nullptr; // Each server's article IDs in increasing order.
+
+  struct RankedMatches {
+    std::vector<uint32_t> termIndices;
+    uint32_t serverIndex;
+    std::shared_ptr<const std::vector<Posting>> matches; // In ranked order.
+  };
+  mutable std::mutex rankedMatchesLock;
+  mutable std::list<RankedMatches> rankedMatches; // Of the queries most recently resumed, most recent first.
+
+  IndexSnapshot() {}
+  bool bindSections();
+  size_t numTerms() const;
+  bool findServer(const std::string& server, uint32_t& serverIndex) const;
+  Article getArticle(uint32_t articleID) const;
+  void fillPage(uint32_t termIndex, size_t start, size_t limit, ResultPage& page) const;
+  std::vector<Posting> intersectTerms(const std::vector<uint32_t>& termIndices, uint32_t serverIndex) const;
+  std::shared_ptr<const std::vector<Posting>> findRankedMatches(const std::vector<uint32_t>& termIndices,
+                                                                uint32_t serverIndex) const;
+  void fillConjunctivePage(const std::vector<uint32_t>& termIndices, uint32_t serverIndex, const Posting *last,
+                           size_t numShown, size_t limit, ResultPage& page) const;
+
+  IndexSnapshot(const IndexSnapshot& original) = delete;
+  IndexSnapshot& operator=(const IndexSnapshot& rhs) = delete;
+};
@@ -0,0 +1,92 @@
+/**
+ * File: index-stats.cc
+ * --------------------
+ * Presents the implementation of the IndexStats record.
+ */
+
+#include "index-stats.h"
+
+#include <algorithm>
+#include <cmath>
+using namespace std;
+
+// Heaps' law exponents for English text usually fall between 0.4 and 0.6.
+static const double kDefaultHeapsBeta = 0.5;
+static const size_t kProjectionScales[] = {100000, 1000000, 10000000};
+
+void IndexStats::summarizePostingsLengths(vector<size_t>& lengths) {
+  postingsLengthHistogram.clear();
+  if (lengths.empty()) return;
+
+  size_t total = 0;
+  for (size_t length : lengths) {
+    total += length;
+    size_t bucket = 0;
+    while ((size_t(2) << bucket) <= length) bucket++;
+    if (bucket >= postingsLengthHistogram.size()) postingsLengthHistogram.resize(bucket + 1);
+    postingsLengthHistogram[bucket]++;
+  }
+  meanDocumentFrequency = double(total) / lengths.size();
+
+  auto percentile = [&lengths](double fraction) {
+    size_t rank = min(lengths.size() - 1, size_t(fraction * lengths.size()));
+    nth_element(lengths.begin(), lengths.begin() + rank, lengths.end());
+    return lengths[rank];
+  };
+  medianDocumentFrequency = percentile(0.5);
+  p90DocumentFrequency = percentile(0.9);
+  p99DocumentFrequency = percentile(0.99);
+  maxDocumentFrequency = *max_element(lengths.begin(), lengths.end());
+}
+
+double IndexStats::heapsBeta() const {
+  if (numArticles < 4 || halfVocabularySize == 0 || vocabularySize <= halfVocabularySize) return kDefaultHeapsBeta;
+  double beta = log(double(vocabularySize) / halfVocabularySize) / log(2.0);
+  return min(1.0, max(0.1, beta));
+}
+
+size_t IndexStats::projectVocabulary(size_t articles) const {
+  if (numArticles == 0) return 0;
+  return vocabularySize * pow(double(articles) / numArticles, heapsBeta());
+}
+
+size_t IndexStats::projectBytes(size_t articles) const {
+  if (numArticles == 0 || vocabularySize == 0) return 0;
+  double scale = double(articles) / numArticles;
+  double bytesPerTerm = double(dictionaryBytes) / vocabularySize;
+  return projectVocabulary(articles) * bytesPerTerm + (postingsBytes + articleTableBytes) * scale;
+}
+
+void IndexStats::writeJSON(ostream& out) const {
+  out << "{" << endl;
+  out << "  \"articles\": " << numArticles << "," << endl;
+  out << "  \"vocabularySize\": " << vocabularySize << "," << endl;
+  out << "  \"postings\": " << numPostings << "," << endl;
+  out << "  \"occurrences\": " << numOccurrences << "," << endl;
+  out << "  \"documentFrequency\": {\"mean\": " << meanDocumentFrequency
+      << ", \"p50\": " << medianDocumentFrequency << ", \"p90\": " << p90DocumentFrequency
+      << ", \"p99\": " << p99DocumentFrequency << ", \"max\": " << maxDocumentFrequency << "}," << endl;
+
+  out << "  \"postingsLengthHistogram\": [";
+  for (size_t bucket = 0; bucket < postingsLengthHistogram.size(); bucket++) {
+    if (bucket > 0) out << ", ";
+    out << "{\"min\": " << (size_t(1) << bucket) << ", \"lists\": " << postingsLengthHistogram[bucket] << "}";
+  }
+  out << "]," << endl;
+
+  out << "  \"bytes\": {\"dictionary\": " << dictionaryBytes << ", \"postings\": " << postingsBytes
+      << ", \"articleTable\": " << articleTableBytes
+      << ", \"total\": " << dictionaryBytes + postingsBytes + articleTableBytes << "}," << endl;
+
+  out << "  \"heapsBeta\": " << heapsBeta() << "," << endl;
+  out << "  \"projections\": [";
+  bool first = true;
+  for (size_t articles : kProjectionScales) {
+    if (!first) out << ", ";
+    first = false;
+    out << "{\"articles\": " << articles << ", \"vocabularySize\": " << projectVocabulary(articles)
+        << ", \"bytes\": " << projectBytes(articles) << "}";
+  }
+  out << "]" << endl;
+  out << "}" << endl;
+}
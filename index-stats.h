@@ -0,0 +1,71 @@
+/**
+ * File: index-stats.h
+ * -------------------
+ * Defines the IndexStats record, a capacity-planning summary of an index:
+ * how big the vocabulary is, how document frequencies are distributed, how
+ * many bytes each component occupies, and how large all of that is expected
+ * to be at larger article counts.  The vocabulary projection follows Heaps'
+ * law, V(n) = K * n^beta, with beta fitted from the vocabulary of the first
+ * half of the articles against the vocabulary of all of them.
+ */
+
+#pragma once
+#include <cstddef>
+#include <ostream>
+#include <vector>
+
+struct IndexStats {
+  size_t numArticles = 0;
+  size_t vocabularySize = 0;
+  size_t halfVocabularySize = 0; // Distinct terms among the first numArticles / 2 articles.
+  size_t numPostings = 0;
+  size_t numOccurrences = 0; // Sum of every posting's count.
+
+  // Document frequency distribution across terms.
+  double meanDocumentFrequency = 0;
+  size_t medianDocumentFrequency = 0;
+  size_t p90DocumentFrequency = 0;
+  size_t p99DocumentFrequency = 0;
+  size_t maxDocumentFrequency = 0;
+
+  // Bucket i counts the posting lists whose length lies in [2^i, 2^(i + 1)).
+  std::vector<size_t> postingsLengthHistogram;
+
+  size_t dictionaryBytes = 0;
+  size_t postingsBytes = 0;
+  size_t articleTableBytes = 0;
+
+/**
+ * Method: summarizePostingsLengths
+ * --------------------------------
+ * Fills in the distribution fields from the length of every posting list.
+ * The vector is reordered in the process.
+ */
+  void summarizePostingsLengths(std::vector<size_t>& lengths);
+
+/**
+ * Method: projectBytes
+ * --------------------
+ * Estimates the total number of bytes the index would occupy at the
+ * supplied number of articles, scaling postings and articles linearly and
+ * the dictionary along the fitted Heaps' law curve.
+ */
+  size_t projectBytes(size_t articles) const;
+
+/**
+ * Method: writeJSON
+ * -----------------
+ * Prints the statistics, plus projections at a handful of larger
+ * scales, to the supplied stream as a single JSON object.
+ */
+  void writeJSON(std::ostream& out) const;
+
+/**
+ * Methods: heapsBeta, projectVocabulary
+ * -------------------------------------
+ * The fitted Heaps' law exponent, and the vocabulary size it predicts at
+ * the supplied number of articles.
+ */
+  double heapsBeta() const;
+  size_t projectVocabulary(size_t articles) const;
+};
@@ -0,0 +1,81 @@
+/**
+ * File: index-warmup.cc
+ * ---------------------
+ * Presents the implementation of the snapshot warmup routines.
+ */
+
+#include "index-warmup.h"
+
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <fstream>
+#include <set>
+#include <unordered_map>
+using namespace std;
+
+// Each pool task touches at most this many bytes, so a few huge lists still spread across workers.
+static const size_t kBytesPerTask = 1 << 20;
+
+static void touchPages(const char *start, size_t length, size_t pageSize) {
+  volatile char sink = 0;
+  for (size_t offset = 0; offset < length; offset += pageSize) sink += start[offset];
+  if (length > 0) sink += start[length - 1];
+  (void) sink;
+}
+
+size_t warmUpSnapshot(const IndexSnapshot& snapshot, develop::ThreadPool& pool,
+                      const vector<string>& queryLog, size_t numHotTerms) {
+  unordered_map<string, size_t> queryCounts;
+  for (const string& term : queryLog) queryCounts[term]++;
+  vector<pair<size_t, uint32_t>> logged;
+  for (const pair<const string, size_t>& entry : queryCounts) {
+    uint32_t termIndex;
+    if (snapshot.findTerm(entry.first, termIndex)) logged.push_back(make_pair(entry.second, termIndex));
+  }
+  sort(logged.rbegin(), logged.rend());
+
+  set<uint32_t> hotTerms;
+  for (size_t i = 0; i < logged.size() && hotTerms.size() < numHotTerms; i++) hotTerms.insert(logged[i].second);
+  for (uint32_t termIndex : snapshot.getMostFrequentTerms(numHotTerms)) {
+    if (hotTerms.size() >= numHotTerms) break;
+    hotTerms.insert(termIndex);
+  }
+
+  vector<IndexSnapshot::Region> regions = {snapshot.getDictionaryRegion(), snapshot.getArticleRegion()};
+  for (uint32_t termIndex : hotTerms) {
+    vector<IndexSnapshot::Region> postingsRegions = snapshot.getPostingsRegions(termIndex);
+    regions.insert(regions.end(), postingsRegions.begin(), postingsRegions.end());
+  }
+
+  size_t pageSize = sysconf(_SC_PAGESIZE);
+  size_t numBytes = 0;
+  for (const IndexSnapshot::Region& region : regions) {
+    if (region.length == 0) continue;
+    numBytes += region.length;
+    if (snapshot.isMapped()) {
+      uintptr_t start = reinterpret_cast<uintptr_t>(region.start) & ~(pageSize - 1);
+      size_t length = reinterpret_cast<uintptr_t>(region.start) + region.length - start;
+      madvise(reinterpret_cast<void *>(start), length, MADV_WILLNEED);
+    }
+    for (size_t offset = 0; offset < region.length; offset += kBytesPerTask) {
+      const char *start = region.start + offset;
+      size_t length = min(kBytesPerTask, region.length - offset);
+      pool.schedule([start, length, pageSize] { touchPages(start, length, pageSize); });
+    }
+  }
+  pool.wait();
+  return numBytes;
+}
+
+vector<string> readQueryLog(const string& path) {
+  vector<string> terms;
+  ifstream in(path);
+  string term;
+  while (getline(in, term)) {
+    if (!term.empty()) terms.push_back(term);
+  }
+  return terms;
+}
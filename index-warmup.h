@@ -0,0 +1,37 @@
+/**
+ * File: index-warmup.h
+ * --------------------
+ * Exports the routines that warm a memory-mapped IndexSnapshot before it takes
+ * queries.  Left alone, the first query for each term page-faults its way
+ * through the dictionary and postings, which is what ruins cold-start tail
+ * latency right after a deploy.  Warming advises the kernel of the regions
+ * we're about to need and then touches every page of them from the pool.
+ */
+
+#pragma once
+#include <string>
+#include <vector>
+
+#include "index-snapshot.h"
+#include "thread-pool.h"
+
+/**
+ * Function: warmUpSnapshot
+ * ------------------------
+ * Prefaults the dictionary, the article table and the postings of the hot
+ * terms (both the ranked lists and the article IDs and counts intersected
+ * by conjunctive queries), spreading the page touching across the supplied
+ * pool and waiting for it to finish.  The hot terms are the most frequent entries of the
+ * query log, topped up with the terms having the longest posting lists
+ * until numHotTerms have been chosen.  Returns the number of bytes warmed.
+ */
+size_t warmUpSnapshot(const IndexSnapshot& snapshot, develop::ThreadPool& pool,
+                      const std::vector<std::string>& queryLog, size_t numHotTerms);
+
+/**
+ * Function: readQueryLog
+ * ----------------------
+ * Returns every (already normalized) term recorded in the supplied query log,
+ * one per line.  A missing log is simply an empty one.
+ */
+std::vector<std::string> readQueryLog(const std::string& path);
@@ -0,0 +1,136 @@
+/**
+ * File: intersection-bench.cc
+ * ---------------------------
+ * A standalone benchmark that times each sorted-list intersection kernel
+ * (see sorted-intersection.h) against std::set_intersection, on pairs of
+ * lists of similar size and on pairs where one list is much shorter than
+ * the other, which is where galloping is meant to take over.
+ *
+ * Lists are random, sorted, duplicate-free article IDs drawn from a range a
+ * few times the longer list's length, so that a realistic fraction of the
+ * shorter list matches.  Every kernel must find the same number of matches
+ * as std::set_intersection, or the benchmark reports the mismatch and fails.
+ *
+ * Usage: intersection-bench [<repetitions>]
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <iterator>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "sorted-intersection.h"
+using namespace std;
+
+static const size_t kDefaultRepetitions = 200;
+static const uint32_t kIDRangeFactor = 4; // IDs are drawn from [0, 4 * longer length)
+
+/**
+ * Struct: Workload
+ * ----------------
+ * One pair of list lengths to time every kernel on.
+ */
+struct Workload {
+  size_t aLength;
+  size_t bLength;
+};
+
+static const Workload kWorkloads[] = {
+  {1000, 1000}, {100000, 100000}, {100000, 50000},
+  {1000, 100000}, {100, 1000000}, {16, 1000000},
+};
+
+static vector<uint32_t> makeList(size_t length, uint32_t range, mt19937& generator) {
+  uniform_int_distribution<uint32_t> distribution(0, range - 1);
+  vector<uint32_t> list;
+  while (list.size() < length) {
+    for (size_t i = list.size(); i < length; i++) list.push_back(distribution(generator));
+    sort(list.begin(), list.end());
+    list.erase(unique(list.begin(), list.end()), list.end());
+  }
+  return list;
+}
+
+// Returns the nanoseconds one intersection takes on average, and leaves the number of matches in numMatches.
+template <typename Intersect>
+static double timeIntersection(size_t repetitions, size_t& numMatches, Intersect intersect) {
+  numMatches = intersect(); // warms the caches and the branch predictors
+  chrono::steady_clock::time_point start = chrono::steady_clock::now();
+  for (size_t i = 0; i < repetitions; i++) numMatches = intersect();
+  return chrono::duration<double, nano>(chrono::steady_clock::now() - start).count() / repetitions;
+}
+
+static void printTiming(const string& label, double nanoseconds, double baseline) {
+  cout << "  " << left << setw(22) << label << right << setw(12) << fixed << setprecision(0) << nanoseconds
+       << " ns" << setw(8) << setprecision(2) << baseline / nanoseconds << "x" << endl;
+}
+
+int main(int argc, char *argv[]) {
+  size_t repetitions = kDefaultRepetitions;
+  if (argc > 2) {
+    cerr << "Usage: " << argv[0] << " [<repetitions>]" << endl;
+    return 1;
+  }
+  if (argc == 2) repetitions = strtoul(argv[1], NULL, 10);
+  if (repetitions == 0) {
+    cerr << "The number of repetitions must be positive." << endl;
+    return 1;
+  }
+
+  const struct {
+    IntersectionKernel kernel;
+    const char *label;
+  } kernels[] = {
+    {ScalarMerge, "scalar merge"}, {SSE2Blocks, "SSE2 blocks"},
+    {AVX2Blocks, "AVX2 blocks"}, {Galloping, "galloping"},
+  };
+
+  mt19937 generator(20240611);
+  bool consistent = true;
+  for (const Workload& workload : kWorkloads) {
+    uint32_t range = kIDRangeFactor * max(workload.aLength, workload.bLength);
+    vector<uint32_t> a = makeList(workload.aLength, range, generator);
+    vector<uint32_t> b = makeList(workload.bLength, range, generator);
+    size_t capacity = min(a.size(), b.size());
+    vector<uint32_t> values(capacity), aPositions(capacity), bPositions(capacity);
+
+    size_t expected;
+    double baseline = timeIntersection(repetitions, expected, [&] {
+      return size_t(set_intersection(a.begin(), a.end(), b.begin(), b.end(), values.begin()) - values.begin());
+    });
+    cout << a.size() << " x " << b.size() << " (" << expected << " matches, average of " << repetitions
+         << " runs, speedup over std::set_intersection):" << endl;
+    printTiming("std::set_intersection", baseline, baseline);
+
+    for (const auto& entry : kernels) {
+      if (!supportsIntersectionKernel(entry.kernel)) {
+        cout << "  " << left << setw(22) << entry.label << right << "  (unsupported on this CPU)" << endl;
+        continue;
+      }
+      size_t numMatches;
+      double nanoseconds = timeIntersection(repetitions, numMatches, [&] {
+        return intersectSortedPositionsWith(entry.kernel, a.data(), a.size(), b.data(), b.size(),
+                                            aPositions.data(), bPositions.data());
+      });
+      printTiming(entry.label, nanoseconds, baseline);
+      if (numMatches != expected) {
+        cout << "  " << entry.label << " found " << numMatches << " matches, not " << expected << "!" << endl;
+        consistent = false;
+      }
+    }
+
+    size_t numMatches;
+    double nanoseconds = timeIntersection(repetitions, numMatches, [&] {
+      return intersectSortedPositions(a.data(), a.size(), b.data(), b.size(), aPositions.data(), bPositions.data());
+    });
+    printTiming("as dispatched", nanoseconds, baseline);
+    if (numMatches != expected) consistent = false;
+  }
+  return consistent ? 0 : 1;
+}
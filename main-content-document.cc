@@ -0,0 +1,344 @@
+/**
+ * File: main-content-document.cc
+ * ------------------------------
+ * Presents the implementation of the MainContentDocument class.
+ */
+
+#include "main-content-document.h"
+
+#include <libxml/HTMLparser.h>
+#include <libxml/tree.h>
+#include <libxml/xmlIO.h>
+
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <unordered_map>
+#include <unordered_set>
+
+#include "html-document-exception.h"
+#include "text-normalization.h"
+using namespace std;
+
+// Subtrees rooted at these elements are never visible text.
+static const unordered_set<string> kInvisibleTags = {"script", "style", "noscript", "template"};
+
+// Subtrees rooted at these elements are never article text.
+static const unordered_set<string> kBoilerplateTags = {
+  "script", "style", "noscript", "template", "iframe", "object", "embed", "svg", "canvas",
+  "nav", "footer", "aside", "button", "select", "textarea",
+};
+
+// A class or id containing one of these marks boilerplate, unless it also contains one of kContentHints.
+static const char *const kBoilerplateHints[] = {
+  "nav", "menu", "footer", "cookie", "consent", "banner", "sidebar", "related", "share", "social",
+  "comment", "promo", "newsletter", "subscribe", "breadcrumb", "advert", "sponsor", "popup", "masthead",
+};
+static const char *const kContentHints[] = {"article", "content", "main", "body", "story", "entry"};
+
+// Paragraph-like blocks whose text scores their ancestors.
+static const unordered_set<string> kParagraphTags = {"p", "pre", "td", "blockquote"};
+
+static const size_t kMinParagraphLength = 25;
+static const double kMaxParagraphLinkDensity = 0.5;
+static const double kMinSiblingScore = 10;
+static const double kSiblingScoreFraction = 0.2;
+static const size_t kMinLooseParagraphLength = 80;
+static const double kMaxLooseParagraphLinkDensity = 0.25;
+
+// No article needs more than this; anything past it is truncated rather than read or parsed.
+static const size_t kMaxBodyBytes = 4 << 20;
+static const size_t kMaxTokens = 100000;
+
+namespace {
+struct NodeStats {
+  size_t textLength = 0; // Non-whitespace bytes of visible text.
+  size_t linkLength = 0; // The part of textLength inside links.
+  size_t numCommas = 0;
+  double score = 0;
+};
+
+typedef unordered_map<const xmlNode *, NodeStats> StatsMap;
+}
+
+static bool isNamed(const xmlNode *node, const char *name) {
+  return node->type == XML_ELEMENT_NODE && strcmp(reinterpret_cast<const char *>(node->name), name) == 0;
+}
+
+static bool containsAny(const string& attribute, const char *const *hints, size_t numHints) {
+  for (size_t i = 0; i < numHints; i++) {
+    if (attribute.find(hints[i]) != string::npos) return true;
+  }
+  return false;
+}
+
+static string getLowercaseAttribute(const xmlNode *node, const char *name) {
+  xmlChar *value = xmlGetProp(node, reinterpret_cast<const xmlChar *>(name));
+  if (value == NULL) return "";
+  string attribute(reinterpret_cast<const char *>(value));
+  xmlFree(value);
+  for (char& ch : attribute) ch = tolower(static_cast<unsigned char>(ch));
+  return attribute;
+}
+
+/**
+ * Function: isBoilerplate
+ * -----------------------
+ * Returns true if the supplied element and everything beneath it should be ignored.
+ */
+static bool isBoilerplate(const xmlNode *node) {
+  const char *name = reinterpret_cast<const char *>(node->name);
+  if (kBoilerplateTags.count(name)) return true;
+  if (isNamed(node, "html") || isNamed(node, "body")) return false;
+  string labels = getLowercaseAttribute(node, "class") + " " + getLowercaseAttribute(node, "id");
+  if (labels.size() == 1) return false;
+  return containsAny(labels, kBoilerplateHints, sizeof(kBoilerplateHints) / sizeof(kBoilerplateHints[0])) &&
+         !containsAny(labels, kContentHints, sizeof(kContentHints) / sizeof(kContentHints[0]));
+}
+
+static double getLinkDensity(const NodeStats& stats) {
+  return stats.textLength == 0 ? 0 : double(stats.linkLength) / stats.textLength;
+}
+
+/**
+ * Function: scoreNodes
+ * --------------------
+ * Computes the text statistics of every element beneath (and including) the
+ * supplied one in a single post-order pass, crediting each qualifying
+ * paragraph's parent and grandparent as it goes.  Boilerplate elements are
+ * left out of the map altogether.
+ */
+static NodeStats scoreNodes(const xmlNode *node, bool inLink, StatsMap& statsByNode) {
+  NodeStats stats;
+  for (const xmlNode *child = node->children; child != NULL; child = child->next) {
+    if (child->type == XML_TEXT_NODE || child->type == XML_CDATA_SECTION_NODE) {
+      for (const xmlChar *ch = child->content; ch != NULL && *ch != '\0'; ch++) {
+        if (isspace(*ch)) continue;
+        stats.textLength++;
+        if (*ch == ',') stats.numCommas++;
+      }
+    } else if (child->type == XML_ELEMENT_NODE && !isBoilerplate(child)) {
+      NodeStats childStats = scoreNodes(child, inLink || isNamed(child, "a"), statsByNode);
+      stats.textLength += childStats.textLength;
+      stats.linkLength += childStats.linkLength;
+      stats.numCommas += childStats.numCommas;
+    }
+  }
+  if (inLink) stats.linkLength = stats.textLength;
+
+  const char *name = reinterpret_cast<const char *>(node->name);
+  if (kParagraphTags.count(name) && stats.textLength >= kMinParagraphLength &&
+      getLinkDensity(stats) <= kMaxParagraphLinkDensity && node->parent != NULL) {
+    double score = 1 + stats.numCommas + min<double>(stats.textLength / 100, 3);
+    const xmlNode *parent = node->parent;
+    statsByNode[parent].score += score;
+    if (parent->parent != NULL && parent->parent->type == XML_ELEMENT_NODE)
+      statsByNode[parent->parent].score += score / 2;
+  }
+
+  NodeStats& recorded = statsByNode[node];
+  double score = recorded.score; // Descendants may already have credited this node.
+  recorded = stats;
+  recorded.score = score;
+  return recorded;
+}
+
+static bool isSeparator(const unsigned char *text, size_t& length) {
+  if (*text < 0x80) {
+    length = 1;
+    return !isalnum(*text);
+  }
+  // U+00A0 (no-break space) and U+2000 through U+206F (spaces, dashes, quotes) separate words too.
+  if (text[0] == 0xC2 && text[1] == 0xA0) {
+    length = 2;
+    return true;
+  }
+  if (text[0] == 0xE2 && (text[1] == 0x80 || text[1] == 0x81) && text[2] != '\0') {
+    length = 3;
+    return true;
+  }
+  length = 1;
+  return false;
+}
+
+static void appendTokens(const string& content, vector<string>& tokens) {
+  const unsigned char *text = reinterpret_cast<const unsigned char *>(content.c_str());
+  const unsigned char *wordStart = NULL;
+  while (*text != '\0' && tokens.size() < kMaxTokens) {
+    size_t length;
+    if (isSeparator(text, length)) {
+      if (wordStart != NULL) tokens.emplace_back(reinterpret_cast<const char *>(wordStart), text - wordStart);
+      wordStart = NULL;
+    } else if (wordStart == NULL) {
+      wordStart = text;
+    }
+    text += length;
+  }
+  if (wordStart != NULL && tokens.size() < kMaxTokens)
+    tokens.emplace_back(reinterpret_cast<const char *>(wordStart), text - wordStart);
+}
+
+static bool isSkipped(const xmlNode *node, bool skipBoilerplate) {
+  if (skipBoilerplate) return isBoilerplate(node);
+  return kInvisibleTags.count(reinterpret_cast<const char *>(node->name)) > 0;
+}
+
+static void collectText(const xmlNode *node, bool skipBoilerplate, string& text) {
+  for (const xmlNode *child = node->children; child != NULL; child = child->next) {
+    if (child->type == XML_TEXT_NODE || child->type == XML_CDATA_SECTION_NODE) {
+      if (child->content == NULL) continue;
+      text += reinterpret_cast<const char *>(child->content);
+      text += ' ';
+    } else if (child->type == XML_ELEMENT_NODE && !isSkipped(child, skipBoilerplate)) {
+      collectText(child, skipBoilerplate, text);
+    }
+  }
+}
+
+static const xmlNode *findBody(const xmlNode *root) {
+  for (const xmlNode *child = root->children; child != NULL; child = child->next) {
+    if (isNamed(child, "body")) return child;
+  }
+  return root;
+}
+
+/**
+ * Function: extractMainContent
+ * ----------------------------
+ * Appends the text of the main content beneath root to text, or all of its
+ * visible text if no element stands out.
+ */
+static void extractMainContent(const xmlNode *root, string& text) {
+  const xmlNode *body = findBody(root);
+  StatsMap statsByNode;
+  scoreNodes(body, false, statsByNode);
+
+  const xmlNode *top = NULL;
+  double topScore = 0;
+  for (const pair<const xmlNode *const, NodeStats>& entry : statsByNode) {
+    if (entry.second.textLength == 0) continue; // only credited, never scanned (e.g. <html>)
+    double score = entry.second.score * (1 - getLinkDensity(entry.second));
+    if (score > topScore) {
+      top = entry.first;
+      topScore = score;
+    }
+  }
+  if (top == NULL || top == body || top->parent == NULL) {
+    collectText(body, false, text);
+    return;
+  }
+
+  double siblingThreshold = max(kMinSiblingScore, topScore * kSiblingScoreFraction);
+  for (const xmlNode *sibling = top->parent->children; sibling != NULL; sibling = sibling->next) {
+    if (sibling->type != XML_ELEMENT_NODE) continue;
+    StatsMap::const_iterator found = statsByNode.find(sibling);
+    if (found == statsByNode.end()) continue; // boilerplate
+    const NodeStats& stats = found->second;
+    bool keep = sibling == top || stats.score * (1 - getLinkDensity(stats)) >= siblingThreshold ||
+                (isNamed(sibling, "p") && stats.textLength >= kMinLooseParagraphLength &&
+                 getLinkDensity(stats) < kMaxLooseParagraphLinkDensity);
+    if (keep) collectText(sibling, true, text);
+  }
+}
+
+MainContentDocument::MainContentDocument(const string& url, bool stripBoilerplate)
+  : url(url), stripBoilerplate(stripBoilerplate) {}
+
+static const int kReadChunkSize = 16 * 1024;
+void MainContentDocument::download() {
+  // libxml's own input layer, so the same URLs htmlReadFile accepts (http, files, gzip) work here.
+  xmlParserInputBufferPtr input = xmlParserInputBufferCreateFilename(url.c_str(), XML_CHAR_ENCODING_NONE);
+  if (input == NULL) throw HTMLDocumentException("Unable to fetch \"" + url + "\".");
+  int numRead;
+  bool sniffed = false;
+  while ((numRead = xmlParserInputBufferGrow(input, kReadChunkSize)) > 0) {
+    const char *received = reinterpret_cast<const char *>(xmlBufContent(input->buffer));
+    size_t numReceived = xmlBufUse(input->buffer);
+    if (!sniffed && looksBinary(received, numReceived)) {
+      xmlFreeParserInputBuffer(input);
+      throw HTMLDocumentException("\"" + url + "\" isn't HTML.");
+    }
+    sniffed = true;
+    if (numReceived >= kMaxBodyBytes) break;
+  }
+  if (numRead < 0) {
+    xmlFreeParserInputBuffer(input);
+    throw HTMLDocumentException("Unable to fetch \"" + url + "\".");
+  }
+  body.assign(reinterpret_cast<const char *>(xmlBufContent(input->buffer)), min<size_t>(xmlBufUse(input->buffer), kMaxBodyBytes));
+  xmlFreeParserInputBuffer(input);
+  downloaded = true;
+}
+
+void MainContentDocument::download(HttpFetcher& fetcher) {
+  if (!HttpFetcher::canFetch(url)) {
+    download();
+    return;
+  }
+  HttpFetcher::Limits limits;
+  limits.maxBytes = kMaxBodyBytes;
+  limits.textOnly = true;
+  if (!fetcher.fetch(url, body, limits)) throw HTMLDocumentException("Unable to fetch \"" + url + "\".");
+  downloaded = true;
+}
+
+// Where a page can declare its charset in a meta tag, as HTML's own prescan bounds it.
+static const size_t kMaxCharsetPrescanBytes = 1024;
+
+/**
+ * Function: getDeclaredCharset
+ * ----------------------------
+ * Returns the lowercased charset the body's head declares (in a meta tag or
+ * XML declaration), or the empty string if it declares none.
+ */
+static string getDeclaredCharset(const string& body) {
+  string head = body.substr(0, kMaxCharsetPrescanBytes);
+  transform(head.begin(), head.end(), head.begin(), [](unsigned char ch) { return tolower(ch); });
+  size_t found = head.find("charset=");
+  if (found == string::npos) {
+    found = head.find("encoding=");
+    if (found == string::npos || head.compare(0, 5, "<?xml") != 0) return "";
+  }
+  size_t start = head.find('=', found) + 1;
+  while (start < head.size() && (head[start] == '"' || head[start] == '\'' || isspace(head[start]))) start++;
+  size_t end = start;
+  while (end < head.size() && (isalnum(head[end]) || strchr("-_.:", head[end]) != NULL)) end++;
+  return head.substr(start, end - start);
+}
+
+void MainContentDocument::parse() {
+  static const int kParseOptions = HTML_PARSE_RECOVER | HTML_PARSE_NOERROR | HTML_PARSE_NOWARNING | HTML_PARSE_NOBLANKS;
+  if (!downloaded) download();
+
+  // libxml decodes whatever charset a page declares.  A page that isn't valid UTF-8 but declares no
+  // charset, or declares UTF-8 anyway, is nearly always Windows-1252, which libxml would mangle, so
+  // it's transcoded here first.  Either way, libxml is then told it's reading UTF-8.
+  const string *source = &body;
+  string transcoded;
+  const char *encoding = NULL;
+  if (isValidUTF8(body.data(), body.size())) {
+    encoding = "UTF-8";
+  } else {
+    string declared = getDeclaredCharset(body);
+    if (declared.empty() || declared == "utf-8" || declared == "utf8") {
+      transcoded = transcodeWindows1252(body);
+      source = &transcoded;
+      encoding = "UTF-8";
+    }
+  }
+  htmlDocPtr doc = htmlReadMemory(source->data(), source->size(), url.c_str(), encoding, kParseOptions);
+  if (doc == NULL) throw HTMLDocumentException("Unable to parse \"" + url + "\".");
+  xmlNodePtr root = xmlDocGetRootElement(doc);
+  string text;
+  if (root != NULL) {
+    if (stripBoilerplate) extractMainContent(root, text);
+    else collectText(root, false, text);
+  }
+  xmlFreeDoc(doc);
+
+  // Normalizing all of the text at once, rather than token by token, lets the vector paths cover
+  // long runs, and decodes any entities that were escaped twice before the split breaks them up.
+  normalizeText(text);
+  tokens.clear();
+  appendTokens(text, tokens);
+}
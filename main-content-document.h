@@ -0,0 +1,86 @@
+/**
+ * File: main-content-document.h
+ * -----------------------------
+ * Defines the MainContentDocument class, a drop-in alternative to HTMLDocument
+ * that tokenizes only an article's main content.  Navigation bars, footers,
+ * cookie banners and lists of related links often contribute more tokens than
+ * the article itself, and every one of them costs a dictionary lookup, a slot
+ * in the article's token counts, and eventually a posting.
+ *
+ * The main content is found from text and link density.  Every paragraph-like
+ * block with enough text and few enough links credits its parent (in full)
+ * and grandparent (in half) with a score that grows with its length, and the
+ * best-scoring container, discounted by its own link density, is taken to be
+ * the article.  Sibling blocks that scored well are kept alongside it, since
+ * articles are often split across several containers.  Elements that are
+ * boilerplate by construction (nav, footer, aside, script, and anything whose
+ * class or id says it's a menu, banner, or the like) never contribute.  Pages
+ * without a clear winner fall back to all of their visible text.
+ *
+ * Downloading and parsing are separate steps, so that callers can inspect
+ * the raw body (to recognize one they've already seen, say) before paying
+ * for the parse.
+ *
+ * No one document can monopolize a worker or its memory: bodies served as
+ * something other than text, or that open like a binary file, are abandoned
+ * after their first chunk, and bodies and token lists are truncated at
+ * fixed caps well past any real article.
+ */
+
+#pragma once
+#include <string>
+#include <vector>
+
+#include "http-fetcher.h"
+
+class MainContentDocument {
+ public:
+/**
+ * Constructor: MainContentDocument
+ * --------------------------------
+ * Constructs a document around the supplied URL.  Nothing is fetched until
+ * download or parse is called.  If stripBoilerplate is false, every bit of
+ * visible text is tokenized, just as HTMLDocument does.
+ */
+  MainContentDocument(const std::string& url, bool stripBoilerplate);
+
+/**
+ * Method: download
+ * ----------------
+ * Fetches the raw body of the document, which getBody then returns.
+ * Throws an HTMLDocumentException if the document can't be fetched or
+ * is plainly binary.
+ */
+  void download();
+
+/**
+ * Method: download
+ * ----------------
+ * Fetches the raw body through the supplied HttpFetcher, sharing its
+ * connections, if the URL is one it handles, and as above otherwise.
+ */
+  void download(HttpFetcher& fetcher);
+
+/**
+ * Method: parse
+ * -------------
+ * Downloads the document (unless that's already been done), parses it, and
+ * extracts the tokens of its main content, with the text they come from
+ * already run through normalizeText (see text-normalization.h).  A body that
+ * isn't valid UTF-8 and declares no other charset is transcoded from
+ * Windows-1252 before it's parsed.  Throws an HTMLDocumentException if the
+ * document can't be fetched or parsed.
+ */
+  void parse();
+
+  const std::string& getURL() const { return url; }
+  const std::string& getBody() const { return body; }
+  const std::vector<std::string>& getTokens() const { return tokens; }
+
+ private:
+  std::string url;
+  bool stripBoilerplate;
+  bool downloaded = false;
+  std::string body;
+  std::vector<std::string> tokens;
+};
@@ -11,38 +11,61 @@
 #include <libxml/parser.h>
 
 #include <algorithm>
+#include <cstdlib>
+#include <fstream>
 #include <iomanip>
 #include <iostream>
 #include <memory>
+#include <sstream>
 #include <thread>
 #include <utility>
 
 #include "html-document-exception.h"
-#include "html-document.h"
+#include "feed-document.h"
+#include "feed-list-reader.h"
+#include "main-content-document.h"
 #include "ostreamlock.h"
 #include "rss-feed-exception.h"
 #include "rss-feed-list-exception.h"
-#include "rss-feed-list.h"
-#include "rss-feed.h"
 #include "semaphore.h"
+#include "sorted-intersection.h"
 #include "string-utils.h"
 #include "utils.h"
 using namespace std;
 
 
 static const string kDefaultRSSFeedListURL = "small-feed.xml";
+static const char kCursorPrefix = '>';
 NewsAggregator* NewsAggregator::createNewsAggregator(int argc, char* argv[]) {
   struct option options[] = {
       {"verbose", no_argument, NULL, 'v'},
       {"quiet", no_argument, NULL, 'q'},
       {"url", required_argument, NULL, 'u'},
+      {"keep-stop-words", no_argument, NULL, 'k'},
+      {"no-stemming", no_argument, NULL, 'n'},
+      {"max-df", required_argument, NULL, 'd'},
+      {"stats", required_argument, NULL, 's'},
+      {"load-index", required_argument, NULL, 'l'},
+      {"save-index", required_argument, NULL, 'w'},
+      {"query-log", required_argument, NULL, 'g'},
+      {"keep-boilerplate", no_argument, NULL, 'b'},
+      {"seen-items", required_argument, NULL, 'e'},
+      {"refresh", required_argument, NULL, 'r'},
+      {"frontier", required_argument, NULL, 'f'},
+      {"http2", no_argument, NULL, '2'},
+      {"feed-cache", required_argument, NULL, 'c'},
+      {"query-while-crawling", no_argument, NULL, 'i'},
+      {"host-affinity", no_argument, NULL, 'a'},
       {NULL, 0, NULL, 0},
   };
 
   string rssFeedListURI = kDefaultRSSFeedListURL;
   bool verbose = true;
+  TokenNormalizer::Options normalizerOptions;
+  CrawlOptions crawlOptions;
+  IndexPaths paths;
   while (true) {
-    int ch = getopt_long(argc, argv, "vqu:", options, NULL);
+    int ch = getopt_long(argc, argv, "vqu:knd:s:l:w:g:be:r:f:2c:ia", options, NULL);
     if (ch == -1) break;
     switch (ch) {
       case 'v':
@@ -54,6 +77,59 @@ NewsAggregator* NewsAggregator::createNewsAggregator(int argc, char* argv[]) {
       case 'u':
         rssFeedListURI = optarg;
         break;
+      case 'k':
+        normalizerOptions.removeStopWords = false;
+        break;
+      case 'n':
+        normalizerOptions.stem = false;
+        break;
+      case 'd': {
+        char *end;
+        normalizerOptions.maxDocumentFrequency = strtod(optarg, &end);
+        if (*end != '\0' || normalizerOptions.maxDocumentFrequency <= 0)
+          NewsAggregatorLog::printUsage("--max-df expects a positive fraction.", argv[0]);
+        break;
+      }
+      case 's':
+        paths.stats = optarg;
+        break;
+      case 'l':
+        paths.load = optarg;
+        break;
+      case 'w':
+        paths.save = optarg;
+        break;
+      case 'g':
+        paths.queryLog = optarg;
+        break;
+      case 'b':
+        crawlOptions.stripBoilerplate = false;
+        break;
+      case 'e':
+        paths.seenItems = optarg;
+        break;
+      case 'f':
+        paths.frontier = optarg;
+        break;
+      case '2':
+        crawlOptions.http2 = true;
+        break;
+      case 'c':
+        paths.feedCache = optarg;
+        break;
+      case 'i':
+        crawlOptions.queryWhileCrawling = true;
+        break;
+      case 'a':
+        crawlOptions.hostAffinity = true;
+        break;
+      case 'r': {
+        char *end;
+        crawlOptions.freshnessTarget = strtod(optarg, &end);
+        if (*end != '\0' || crawlOptions.freshnessTarget <= 0 || crawlOptions.freshnessTarget >= 1)
+          NewsAggregatorLog::printUsage("--refresh expects a freshness target strictly between 0 and 1.", argv[0]);
+        break;
+      }
       default:
         NewsAggregatorLog::printUsage("Unrecognized flag.", argv[0]);
     }
@@ -61,19 +137,182 @@ NewsAggregator* NewsAggregator::createNewsAggregator(int argc, char* argv[]) {
 
   argc -= optind;
   if (argc > 0) NewsAggregatorLog::printUsage("Too many arguments.", argv[0]);
-  return new NewsAggregator(rssFeedListURI, verbose);
+  return new NewsAggregator(rssFeedListURI, verbose, normalizerOptions, crawlOptions, paths);
 }
 
 void NewsAggregator::buildIndex() {
   if (built) return;
   built = true;  // optimistically assume it'll all work out
+  bool loaded = !paths.load.empty() && loadIndex();
+  if (!loaded || extendingIndex) {
+    if (crawlOptions.queryWhileCrawling) {
+      publishSnapshot(index.snapshot()); // empty, but queries can start right away
+      crawlThread = thread([this] {
+        crawl();
+        if (!paths.stats.empty()) writeIndexStats();
+      });
+      return;
+    }
+    crawl();
+  }
+  if (!paths.stats.empty()) writeIndexStats();
+}
+
+static const chrono::milliseconds kMinPartialPublishingInterval(2000);
+static const int kMaxPartialPublishingShare = 4; // the crawl gets at least this many times as long as publishing
+void NewsAggregator::crawl() {
   xmlInitParser();
   xmlInitializeCatalog();
+  // The items recorded as seen are exactly those in the index they were saved alongside, so they're
+  // skipped only when that index is being extended.  A crawl from scratch starts a new record.
+  if (extendingIndex) seenItems.load(paths.seenItems);
+  else if (!paths.seenItems.empty()) ofstream(paths.seenItems, ios::trunc);
+  if (!paths.frontier.empty() && !frontier.open(paths.frontier))
+    cerr << "Unable to open the crawl frontier \"" << paths.frontier << "\", so it won't survive a restart." << endl;
+  if (!paths.feedCache.empty() && !feedCache.load(paths.feedCache))
+    cerr << "Ignoring the unreadable feed cache \"" << paths.feedCache << "\"." << endl;
+  if (crawlOptions.queryWhileCrawling) {
+    publishingPartialIndex = true;
+    schedulePartialPublishing(kMinPartialPublishingInterval);
+  }
   processAllFeeds();
-  xmlCatalogCleanup();
-  xmlCleanupParser();
+  if (crawlOptions.queryWhileCrawling) {
+    // Once this returns, no partial snapshot can replace the complete one published below.
+    lock_guard<mutex> lg(publishLock);
+    publishingPartialIndex = false;
+    publishedArticles.clear();
+    lock_guard<mutex> ilg(intermediateIndexLock);
+    unpublishedArticles.clear();
+  }
+  if (!paths.feedCache.empty() && !feedCache.save(paths.feedCache))
+    cerr << "Unable to save the feed cache to \"" << paths.feedCache << "\"." << endl;
+  shared_ptr<const IndexSnapshot> complete = index.snapshot();
+  publishSnapshot(complete);
+  if (!paths.save.empty() && !complete->save(paths.save))
+    cerr << "Unable to save the index to \"" << paths.save << "\"." << endl;
+  if (!paths.seenItems.empty() && !seenItems.save(paths.seenItems))
+    cerr << "Unable to record the indexed items in \"" << paths.seenItems << "\"." << endl;
+  if (isRefreshing()) {
+    refreshScheduler.start(); // libxml stays initialized, since feeds will keep being parsed
+  } else {
+    xmlCatalogCleanup();
+    xmlCleanupParser();
+  }
 }
 
+void NewsAggregator::schedulePartialPublishing(chrono::steady_clock::duration delay) {
+  feedPool.scheduleAfter(delay, [this] {
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    publishPartialIndex();
+    chrono::steady_clock::duration elapsed = chrono::steady_clock::now() - start;
+    if (publishingPartialIndex) {
+      schedulePartialPublishing(max<chrono::steady_clock::duration>(kMinPartialPublishingInterval,
+                                                                     elapsed * kMaxPartialPublishingShare));
+    }
+  });
+}
+
+void NewsAggregator::publishPartialIndex() {
+  lock_guard<mutex> lg(publishLock);
+  if (!publishingPartialIndex) return;
+  PartialIndex revised;
+  intermediateIndexLock.lock();
+  revised.swap(unpublishedArticles);
+  intermediateIndexLock.unlock();
+  if (revised.empty()) return;
+
+  // A revised entry (an article seen again under another URL) replaces the one published before.
+  for (PartialIndex::value_type& entry : revised) publishedArticles[entry.first] = entry.second;
+  vector<const ConcurrentRSSIndex::ArticleTokenCounts *> batch;
+  batch.reserve(publishedArticles.size());
+  for (const PartialIndex::value_type& entry : publishedArticles) batch.push_back(entry.second.get());
+  publishSnapshot(index.snapshot(batch));
+}
+
+static const size_t kNumResumableSnapshots = 8; // partial publishes come every few seconds mid-crawl
+void NewsAggregator::publishSnapshot(const shared_ptr<const IndexSnapshot>& next) {
+  lock_guard<mutex> lg(snapshotOwnerLock);
+  if (snapshotOwner) replacedSnapshots.push_back(snapshotOwner);
+  snapshotOwner = next;
+  snapshot.store(next.get(), memory_order_release);
+  if (replacedSnapshots.size() <= kNumResumableSnapshots) return;
+  // Dropping the last reference waits until no query can still be reading the old snapshot.
+  // This thread may never reach a quiescent state otherwise, so it reports one right away.
+  shared_ptr<const IndexSnapshot> retired = replacedSnapshots.front();
+  replacedSnapshots.pop_front();
+  EpochReclaimer::getInstance().retire([retired] {});
+  EpochReclaimer::getInstance().quiescent();
+}
+
+shared_ptr<const IndexSnapshot> NewsAggregator::findSnapshot(uint64_t generation) const {
+  lock_guard<mutex> lg(snapshotOwnerLock);
+  if (snapshotOwner && snapshotOwner->getGeneration() == generation) return snapshotOwner;
+  for (const shared_ptr<const IndexSnapshot>& replaced : replacedSnapshots) {
+    if (replaced->getGeneration() == generation) return replaced;
+  }
+  return nullptr;
+}
+
+static const size_t kNumHotTermsToWarm = 1000;
+bool NewsAggregator::loadIndex() {
+  shared_ptr<const IndexSnapshot> loaded = IndexSnapshot::load(paths.load);
+  if (!loaded) {
+    cerr << "Unable to load a saved index from \"" << paths.load << "\", so building one instead." << endl;
+    return false;
+  }
+  vector<string> queryLog;
+  if (!paths.queryLog.empty()) queryLog = readQueryLog(paths.queryLog);
+  warmUpSnapshot(*loaded, articlePool, queryLog, kNumHotTermsToWarm);
+  publishSnapshot(loaded);
+  if (paths.seenItems.empty()) return true;
+
+  // With a record of the items already in it, the loaded index seeds one that the crawl extends.
+  vector<ConcurrentRSSIndex::ArticleTokenCounts> articles = loaded->exportArticles(index.getDictionary());
+  vector<const ConcurrentRSSIndex::ArticleTokenCounts *> batch;
+  lock_guard<mutex> lg(intermediateIndexLock);
+  for (const ConcurrentRSSIndex::ArticleTokenCounts& article : articles) {
+    batch.push_back(&article);
+    indexedArticles.insert(make_pair(article.first.title, getURLServer(article.first.url)));
+  }
+  index.addBatch(batch);
+  extendingIndex = true;
+  return true;
+}
+
+void NewsAggregator::writeIndexStats() const {
+  ofstream out(paths.stats);
+  if (!out) {
+    cerr << "Unable to write index statistics to \"" << paths.stats << "\"." << endl;
+    return;
+  }
+  EpochReclaimer::Guard guard;
+  snapshot.load(memory_order_acquire)->computeStats().writeJSON(out);
+}
+
+/**
+ * Function: printMatches
+ * ----------------------
+ * Prints one page of matches, numbered from the page's first rank.
+ */
+static void printMatches(const IndexSnapshot::ResultPage& page) {
+  size_t count = page.firstRank - 1;
+  for (const pair<Article, int>& match : page.matches) {
+    count++;
+    string title = match.first.title;
+    if (shouldTruncate(title)) title = truncate(title);
+    string url = match.first.url;
+    if (shouldTruncate(url)) url = truncate(url);
+    string times = match.second == 1 ? "time" : "times";
+    cout << "  " << setw(2) << setfill(' ') << count << ".) "
+         << "\"" << title << "\" [appears " << match.second << " " << times << "]." << endl;
+    cout << "       \"" << url << "\"" << endl;
+  }
+  if (page.hasMore) {
+    cout << "To see the next page, enter " << kCursorPrefix << page.next.encode() << endl;
+  }
+}
+
+static const string kSitePrefix = "site:";
 void NewsAggregator::queryIndex() const {
   static const size_t kMaxMatchesToShow = 15;
   while (true) {
@@ -82,103 +321,325 @@ void NewsAggregator::queryIndex() const {
     getline(cin, response);
     response = trim(response);
     if (response.empty()) break;
-    const vector<pair<Article, int>>& matches = index.getMatchingArticles(response);
-    if (matches.empty()) {
-      cout << "Ah, we didn't find the term \"" << response << "\". Try again." << endl;
+    EpochReclaimer::getInstance().quiescent(); // Whatever was published while the user typed may be reclaimable now.
+
+    // The crawl or feed refreshes may have published a newer snapshot since the last query.
+    // The guard keeps it alive until this query's results are printed.
+    EpochReclaimer::Guard guard;
+    const IndexSnapshot *current = snapshot.load(memory_order_acquire);
+    shared_ptr<const IndexSnapshot> unpublished;
+    if (current == nullptr) {
+      unpublished = index.snapshot();
+      current = unpublished.get();
+    }
+    if (publishingPartialIndex)
+      cout << "(The crawl is still underway; these results cover the " << current->getNumArticles()
+           << " articles indexed so far.)" << endl;
+
+    IndexSnapshot::ResultPage page;
+    if (response[0] == kCursorPrefix) {
+      // Article IDs and term indices are renumbered in every snapshot, so a cursor only
+      // makes sense to the one that issued it, even when a newer one has been published since.
+      ResultCursor cursor;
+      shared_ptr<const IndexSnapshot> issuer;
+      if (ResultCursor::decode(response.substr(1), cursor)) issuer = findSnapshot(cursor.generation);
+      if (!issuer) {
+        cout << "That page token has expired or isn't valid for this index. Try searching again." << endl;
+        continue;
+      }
+      if (!issuer->resumePage(cursor, kMaxMatchesToShow, page)) {
+        cout << "That page token isn't valid for this index. Try searching again." << endl;
+        continue;
+      }
+      cout << "Here are matches " << page.firstRank << " through " << page.firstRank + page.matches.size() - 1
+           << " of " << page.totalMatches << ":" << endl;
+      printMatches(page);
+      continue;
+    }
+
+    // Every word of the response must appear; stop words and pruned terms are simply ignored.
+    // A word of the form site:<server> instead restricts the matches to articles from that server.
+    vector<string> terms;
+    string server;
+    istringstream words(response);
+    string term;
+    while (words >> term) {
+      if (term.size() > kSitePrefix.size() && equal(kSitePrefix.begin(), kSitePrefix.end(), term.begin(),
+                                                   [](char one, char two) { return one == tolower(two); })) {
+        server = term.substr(kSitePrefix.size());
+        continue;
+      }
+      TokenID termID;
+      if (!normalizer.normalize(term)) continue;
+      if (index.getDictionary().find(term, termID) && normalizer.isPruned(termID)) continue;
+      terms.push_back(term);
+      if (!paths.queryLog.empty()) ofstream(paths.queryLog, ios::app) << term << endl;
+    }
+    if (terms.empty() && !server.empty()) {
+      cout << "Enter at least one term to search for on \"" << server << "\"." << endl;
+      continue;
+    }
+    if (terms.empty()) {
+      cout << "Ah, \"" << response << "\" is too common to be indexed. Try again." << endl;
+      continue;
+    }
+    if (!server.empty() && !current->hasServer(server)) {
+      cout << "Ah, no indexed articles come from \"" << server << "\". Try again." << endl;
+      continue;
+    }
+    if (terms.size() == 1 && server.empty()) page = current->getPage(terms[0], kMaxMatchesToShow);
+    else page = current->getConjunctivePage(terms, kMaxMatchesToShow, server);
+    if (page.totalMatches == 0) {
+      cout << "Ah, we didn't find " << (terms.size() == 1 ? "the term" : "those terms together")
+           << " \"" << response << "\". Try again." << endl;
     } else {
-      cout << "That term appears in " << matches.size() << " article"
-           << (matches.size() == 1 ? "" : "s") << ".  ";
-      if (matches.size() > kMaxMatchesToShow)
+      cout << (terms.size() == 1 ? "That term appears" : "Those terms appear together")
+           << " in " << page.totalMatches << " article"
+           << (page.totalMatches == 1 ? "" : "s") << (server.empty() ? "" : " from " + server) << ".  ";
+      if (page.totalMatches > kMaxMatchesToShow)
         cout << "Here are the top " << kMaxMatchesToShow << " of them:" << endl;
-      else if (matches.size() > 1)
+      else if (page.totalMatches > 1)
         cout << "Here they are:" << endl;
       else
         cout << "Here it is:" << endl;
-      size_t count = 0;
-      for (const pair<Article, int>& match : matches) {
-        if (count == kMaxMatchesToShow) break;
-        count++;
-        string title = match.first.title;
-        if (shouldTruncate(title)) title = truncate(title);
-        string url = match.first.url;
-        if (shouldTruncate(url)) url = truncate(url);
-        string times = match.second == 1 ? "time" : "times";
-        cout << "  " << setw(2) << setfill(' ') << count << ".) "
-             << "\"" << title << "\" [appears " << match.second << " " << times << "]." << endl;
-        cout << "       \"" << url << "\"" << endl;
-      }
+      printMatches(page);
     }
   }
 }
 
 static const size_t kNumFeedWorkers = 10;
 static const size_t kNumArticleWorkers = 50;
-NewsAggregator::NewsAggregator(const string& rssFeedListURI, bool verbose) : log(verbose), rssFeedListURI(rssFeedListURI), built(false), feedPool(kNumFeedWorkers), articlePool(kNumArticleWorkers) {}
+// Feed polls take a second or so, so waiting half that again in the queue, for ten polls' worth of time, is overload.
+static const chrono::milliseconds kFeedQueueDelayTarget(500);
+static const chrono::seconds kFeedQueueDelayInterval(10);
+static FeedRefreshScheduler::Options getRefreshOptions(double freshnessTarget) {
+  FeedRefreshScheduler::Options options;
+  if (freshnessTarget > 0) options.freshnessTarget = freshnessTarget;
+  return options;
+}
+
+NewsAggregator::NewsAggregator(const string& rssFeedListURI, bool verbose, const TokenNormalizer::Options& normalizerOptions, const CrawlOptions& crawlOptions, const IndexPaths& paths) : log(verbose), rssFeedListURI(rssFeedListURI), crawlOptions(crawlOptions), paths(paths), normalizer(normalizerOptions), built(false), refreshScheduler(feedPool, getRefreshOptions(crawlOptions.freshnessTarget), [this](const string& feedURL, vector<FeedItem>& items) { return refreshFeed(feedURL, items); }), feedPool(kNumFeedWorkers), articlePool(kNumArticleWorkers) {
+  HttpFetcher::Options fetcherOptions;
+  if (!crawlOptions.http2) fetcherOptions.multiplex = false;
+  fetcher.reset(new HttpFetcher(fetcherOptions));
+  // Only refresh polls are low priority; the initial crawl's feeds are always admitted.
+  feedPool.setAdmissionControl(kFeedQueueDelayTarget, kFeedQueueDelayInterval);
+}
+
+NewsAggregator::~NewsAggregator() {
+  if (crawlThread.joinable()) crawlThread.join();
+  // Polls in flight still need both pools, so let them finish before either is destroyed.
+  refreshScheduler.stop();
+  feedPool.wait();
+}
 
+static const double kFeedImportance = 2; // Feeds lead to articles, so they go first at equal freshness.
+static const double kArticleImportance = 1;
 void NewsAggregator::processAllFeeds() {
-  RSSFeedList feedList(rssFeedListURI);
+  // Feeds an interrupted run left pending, which get workers of their own once the list checks out.
+  size_t numLeftoverFeeds = frontier.getNumPending(CrawlFrontier::Feed);
+  FeedListReader feedList(rssFeedListURI, paths.feedCache.empty() ? NULL : &feedCache);
+  size_t numFeeds;
   try {
-    feedList.parse();
+    numFeeds = feedList.read([this](const string& feedURL, const string& feedTitle) {
+      if (frontier.push(CrawlFrontier::Feed, feedURL, feedTitle, "", kFeedImportance, 1)) scheduleFeeds(1);
+    });
   } 
   catch (const RSSFeedListException& rfle) {
     return;
   }
   
-  const map<string, string>& feeds = feedList.getFeeds();
-  if (feeds.empty()) {
+  if (numFeeds == 0 && numLeftoverFeeds == 0) {
     cout << "Feed list is technically well-formed, but it's empty!" << endl;
     return;
   }
   
-  launchFeedPool(feeds);
+  scheduleFeeds(numLeftoverFeeds);
+  feedPool.wait();
+
+  // Articles an interrupted run left pending, which no feed listed again this time.
+  scheduleArticles(vector<string>(frontier.getNumPending(CrawlFrontier::Article)));
+  articlePool.wait();
 
-  for (const pair<const pair<string, string>, pair<Article, vector<string>>>& articleBundle : intermediateIndex) {
-    index.add(articleBundle.second.first, articleBundle.second.second);
+  // When extending a loaded index, an article it already holds under another URL is left as it was.
+  vector<const ConcurrentRSSIndex::ArticleTokenCounts *> batch;
+  vector<vector<TokenCount> *> allTokens;
+  for (pair<const pair<string, string>, ConcurrentRSSIndex::ArticleTokenCounts>& articleBundle : intermediateIndex) {
+    if (indexedArticles.count(articleBundle.first)) continue;
+    batch.push_back(&articleBundle.second);
+    allTokens.push_back(&articleBundle.second.second);
   }
+  normalizer.pruneFrequentTerms(allTokens);
+  index.addBatch(batch);
+  lock_guard<mutex> lg(intermediateIndexLock);
+  for (const ConcurrentRSSIndex::ArticleTokenCounts *article : batch)
+    indexedArticles.insert(make_pair(article->first.title, getURLServer(article->first.url)));
+  intermediateIndex.clear();
 }
 
-void NewsAggregator::launchFeedPool(const map<string, string>& feeds) {
-  for (const pair<const string, string>& currentFeed : feeds) {
-    feedPool.schedule([this, currentFeed] {
-      string feedURL = currentFeed.first;
-      string feedTitle = currentFeed.second;
+void NewsAggregator::scheduleFeeds(size_t numFeeds) {
+  // Each thunk takes whichever feed has the highest priority when it runs, not necessarily the one it was scheduled for.
+  for (size_t i = 0; i < numFeeds; i++) {
+    feedPool.schedule([this] {
+      CrawlFrontier::Entry currentFeed;
+      if (!frontier.pop(CrawlFrontier::Feed, currentFeed)) return;
+      string feedURL = currentFeed.url;
 
       seenURLsLock.lock();
       if (seenURLs.count(feedURL)) {
         seenURLsLock.unlock();
+        frontier.complete(feedURL, CrawlFrontier::Skipped);
         return;
       }
       seenURLs.insert(feedURL);
       seenURLsLock.unlock();
 
-      RSSFeed feed(feedURL);
+      FeedDocument feed(feedURL);
       try {
-        feed.parse();
+        if (paths.feedCache.empty()) feed.parse();
+        else feed.parse(feedCache);
       } 
       catch (const RSSFeedException& rfe) {
+        frontier.complete(feedURL, CrawlFrontier::Failed);
         return;
       }
+      frontier.complete(feedURL, CrawlFrontier::Succeeded);
 
-      const vector<Article>& articles = feed.getArticles();
+      const vector<FeedItem>& items = feed.getItems();
 
-      if (articles.empty()) {
+      if (items.empty()) {
         cout << "Feed is technically well-formed, but it's empty!" << endl;
         return;
       }
-      launchArticlePool(articles);
+
+      if (isRefreshing()) refreshScheduler.track(feedURL, items);
+
+      // Items already claimed by another feed (or indexed by an earlier run) are never downloaded.
+      vector<FeedItem> newItems;
+      for (const FeedItem& item : items) {
+        if (seenItems.claim(item)) newItems.push_back(item);
+      }
+      launchArticlePool(newItems);
     });
   }
-  feedPool.wait();
 }
 
-void NewsAggregator::launchArticlePool(const vector<Article>& articles) {
-  for (Article currentArticle : articles) {
-    articlePool.schedule([this, currentArticle] {
+bool NewsAggregator::refreshFeed(const string& feedURL, vector<FeedItem>& items) {
+  FeedDocument feed(feedURL);
+  try {
+    if (paths.feedCache.empty()) feed.parse();
+    else feed.parse(feedCache);
+  }
+  catch (const RSSFeedException& rfe) {
+    return false;
+  }
+  items = feed.getItems();
+
+  vector<FeedItem> newItems;
+  for (const FeedItem& item : items) {
+    if (seenItems.claim(item)) newItems.push_back(item);
+  }
+  if (!newItems.empty()) indexRefreshedItems(newItems);
+  return true;
+}
+
+// Copies of a syndicated article turn up within hours of each other, if at all.
+static const chrono::hours kMaxBodyCacheIdle(6);
+void NewsAggregator::indexRefreshedItems(const vector<FeedItem>& items) {
+  lock_guard<mutex> lg(refreshLock);
+  launchArticlePool(items);
+  bodyCache.expire(kMaxBodyCacheIdle);
+
+  // Terms pruned after the initial crawl stay pruned, so queries and new articles still agree.
+  // An article already indexed under another URL is left as it was.
+  vector<const ConcurrentRSSIndex::ArticleTokenCounts *> batch;
+  intermediateIndexLock.lock();
+  for (pair<const pair<string, string>, ConcurrentRSSIndex::ArticleTokenCounts>& articleBundle : intermediateIndex) {
+    if (!indexedArticles.insert(articleBundle.first).second) continue;
+    vector<TokenCount>& counts = articleBundle.second.second;
+    counts.erase(remove_if(counts.begin(), counts.end(),
+                           [this](const TokenCount& count) { return normalizer.isPruned(count.id); }),
+                 counts.end());
+    batch.push_back(&articleBundle.second);
+  }
+  index.addBatch(batch);
+  intermediateIndex.clear();
+  intermediateIndexLock.unlock();
+  publishSnapshot(index.snapshot());
+  if (!paths.seenItems.empty()) seenItems.save(paths.seenItems);
+}
+
+/**
+ * Function: countTokens
+ * ---------------------
+ * Interns each token and collapses the result into ID-sorted (ID, count) runs.
+ */
+static vector<TokenCount> countTokens(const vector<string>& tokens, TokenDictionary& dictionary) {
+  vector<TokenID> ids;
+  ids.reserve(tokens.size());
+  for (const string& token : tokens) ids.push_back(dictionary.intern(token));
+  sort(ids.begin(), ids.end());
+
+  vector<TokenCount> counts;
+  for (TokenID id : ids) {
+    if (!counts.empty() && counts.back().id == id) counts.back().count++;
+    else counts.push_back({id, 1});
+  }
+  return counts;
+}
+
+/**
+ * Function: intersectTokenCounts
+ * ------------------------------
+ * Intersects two ID-sorted run lists, keeping the smaller count of each
+ * shared token, which is exactly what set_intersection produces on the
+ * equivalent sorted multisets of tokens.  The IDs are pulled out into
+ * plain arrays so the SIMD kernels can do the matching.
+ */
+static vector<TokenCount> intersectTokenCounts(const vector<TokenCount>& one, const vector<TokenCount>& two) {
+  vector<uint32_t> oneIDs(one.size()), twoIDs(two.size());
+  for (size_t i = 0; i < one.size(); i++) oneIDs[i] = one[i].id;
+  for (size_t j = 0; j < two.size(); j++) twoIDs[j] = two[j].id;
+  vector<uint32_t> onePositions(min(one.size(), two.size())), twoPositions(onePositions.size());
+  size_t numCommon = intersectSortedPositions(oneIDs.data(), oneIDs.size(), twoIDs.data(), twoIDs.size(),
+                                              onePositions.data(), twoPositions.data());
+  vector<TokenCount> intersection(numCommon);
+  for (size_t k = 0; k < numCommon; k++) {
+    const TokenCount& fromOne = one[onePositions[k]];
+    intersection[k] = {fromOne.id, min(fromOne.count, two[twoPositions[k]].count)};
+  }
+  return intersection;
+}
+
+void NewsAggregator::launchArticlePool(const vector<FeedItem>& items) {
+  vector<string> hosts;
+  time_t now = time(NULL);
+  for (const FeedItem& item : items) {
+    double freshness = CrawlFrontier::getFreshness(item.published, now);
+    if (frontier.push(CrawlFrontier::Article, item.article.url, item.article.title, item.guid, kArticleImportance, freshness))
+      hosts.push_back(getURLServer(item.article.url));
+  }
+  scheduleArticles(hosts);
+  articlePool.wait();
+}
+
+void NewsAggregator::scheduleArticles(const vector<string>& hosts) {
+  // Like the feed thunks, each article thunk takes the highest-priority article pending when it runs.
+  // With host affinity, it takes one from its own host if it can, so that one worker tends to see all
+  // of a host's articles.  That's off by default: measured with affinity-driver, it saved no connections.
+  for (const string& scheduledHost : hosts) {
+    string host = crawlOptions.hostAffinity ? scheduledHost : string();
+    function<void(void)> fetchArticle = [this, host] {
+      CrawlFrontier::Entry entry;
+      if (!frontier.pop(CrawlFrontier::Article, entry, host)) return;
+      FeedItem item = {{entry.url, entry.title}, entry.guid, canonicalizeURL(entry.url), 0};
+      const Article& currentArticle = item.article;
       string articleURL = currentArticle.url;
       
       seenURLsLock.lock();
       if (seenURLs.count(articleURL)) {
         seenURLsLock.unlock();
+        frontier.complete(articleURL, CrawlFrontier::Skipped);
         return;
       }
       seenURLs.insert(articleURL);
@@ -187,34 +648,51 @@ void NewsAggregator::launchArticlePool(const vector<Article>& articles) {
       string articleTitle = currentArticle.title;
       pair<string, string> articleIden = make_pair(articleTitle, getURLServer(articleURL));
 
-      HTMLDocument document(articleURL);
+      MainContentDocument document(articleURL, crawlOptions.stripBoilerplate);
+      vector<TokenCount> sortedTokens;
       try {
-        document.parse();
-      } 
+        document.download(*fetcher);
+        // A body identical to one already tokenized reuses its counts and skips the parse.
+        BodyTokenCache::BodyKey bodyKey = bodyCache.hashBody(document.getBody());
+        shared_ptr<const vector<TokenCount>> cachedTokens = bodyCache.find(bodyKey);
+        if (cachedTokens) {
+          sortedTokens = *cachedTokens;
+        } else {
+          document.parse();
+          vector<string> normalizedTokens = document.getTokens();
+          normalizer.normalizeAll(normalizedTokens);
+          sortedTokens = countTokens(normalizedTokens, index.getDictionary());
+          bodyCache.insert(bodyKey, sortedTokens);
+        }
+      }
       catch (const HTMLDocumentException& hde) {
+        // Nothing was indexed, so the next poll that lists the item may try it again.
+        seenURLsLock.lock();
+        seenURLs.erase(articleURL);
+        seenURLsLock.unlock();
+        seenItems.release(item);
+        frontier.complete(articleURL, CrawlFrontier::Failed);
         return;
       }
-
-      const vector<string>& origTokens = document.getTokens();
-      vector<string> sortedTokens = origTokens;
-      sort(sortedTokens.begin(), sortedTokens.end());
+      seenItems.recordIndexed(item);
 
       intermediateIndexLock.lock();
       if (intermediateIndex.count(articleIden)) {
         string existingURL = intermediateIndex[articleIden].first.url;
         Article revisedArticle = currentArticle;
         revisedArticle.url = existingURL < articleURL ? existingURL : articleURL;
-        vector<string> existingTokens = intermediateIndex[articleIden].second;
-        vector<string> intersectTokens;
-        set_intersection(intermediateIndex[articleIden].second.cbegin(), intermediateIndex[articleIden].second.cend(), sortedTokens.cbegin(), sortedTokens.cend(), back_inserter(intersectTokens));
+        vector<TokenCount> intersectTokens = intersectTokenCounts(intermediateIndex[articleIden].second, sortedTokens);
         intermediateIndex[articleIden] = make_pair(revisedArticle, intersectTokens);
-        intermediateIndexLock.unlock();
       } 
       else {
         intermediateIndex[articleIden] = make_pair(currentArticle, sortedTokens);
-        intermediateIndexLock.unlock();
       }
-    });
+      if (publishingPartialIndex)
+        unpublishedArticles[articleIden] = make_shared<const ConcurrentRSSIndex::ArticleTokenCounts>(intermediateIndex[articleIden]);
+      intermediateIndexLock.unlock();
+      frontier.complete(articleURL, CrawlFrontier::Succeeded);
+    };
+    if (host.empty()) articlePool.schedule(fetchArticle);
+    else articlePool.schedule(host, fetchArticle);
   }
-  articlePool.wait();
 }
\ No newline at end of file
@@ -10,18 +10,30 @@
 #pragma once
 #include <string>
 #include <vector>
+#include <deque>
 #include <map>
 #include <set>
 #include <mutex>
 #include <memory>
+#include <atomic>
+#include <chrono>
+#include <thread>
 
 #include "log.h"
-#include "rss-index.h"
-#include "html-document.h"
+#include "body-token-cache.h"
+#include "concurrent-rss-index.h"
+#include "crawl-frontier.h"
+#include "epoch-reclaimer.h"
+#include "feed-cache.h"
+#include "feed-refresh-scheduler.h"
+#include "index-warmup.h"
+#include "http-fetcher.h"
 #include "article.h"
 #include "thread-pool-release.h"
 #include "thread-pool.h"
+#include "seen-item-set.h"
 #include "semaphore.h"
+#include "token-normalizer.h"
 
 namespace tp = develop;
 using tp::ThreadPool;
@@ -44,7 +56,12 @@ class NewsAggregator {
  * ------------------
  * Pulls the embedded RSSFeedList, parses it, parses the
  * RSSFeeds, and finally parses the HTMLDocuments they
- * reference to actually build the index.
+ * reference to actually build the index.  If a saved index
+ * was supplied, it is mapped and warmed up instead, unless a seen-items
+ * file was supplied too, in which case the crawl extends it.  If a stats
+ * path was supplied, the index statistics are written there as JSON.
+ * When querying while crawling, the crawl continues in the background
+ * and this returns as soon as it has started.
  */
   void buildIndex();
 
@@ -52,9 +69,21 @@ class NewsAggregator {
  * Method: queryIndex
  * ------------------
  * Provides the read-query-print loop that allows the user to
- * query the index to list articles.
+ * query the index to list articles.  A search of several words lists
+ * the articles containing all of them, and a word of the form
+ * site:<server> keeps only the articles from that server.  Long result lists are shown a
+ * page at a time, and each page ends with an opaque token that,
+ * entered back in, resumes after the last match shown.
  */
   void queryIndex() const;
+
+/**
+ * Destructor: ~NewsAggregator
+ * ---------------------------
+ * Waits for a background crawl to finish, stops refreshing feeds, and waits
+ * for any refresh already underway to finish.
+ */
+  ~NewsAggregator();
   
  private:
 
@@ -70,11 +99,53 @@ class NewsAggregator {
   typedef std::string url;
   typedef std::string server;
   typedef std::string title;
+
+/**
+ * Private Type: CrawlOptions
+ * --------------------------
+ * Controls how articles are downloaded and turned into tokens.
+ */
+  struct CrawlOptions {
+    bool stripBoilerplate = true; // Index only each article's main content (see main-content-document.h).
+    double freshnessTarget = 0; // If nonzero, keep polling feeds after the crawl (see feed-refresh-scheduler.h).
+    bool http2 = false; // Multiplex article downloads over one HTTP/2 connection per host (see http-fetcher.h).
+    bool queryWhileCrawling = false; // Crawl in the background, publishing partial snapshots for queries as it goes.
+    bool hostAffinity = false; // Key article downloads by host, so one worker tends to fetch all of a host's articles.
+  };
+
+/**
+ * Private Type: IndexPaths
+ * ------------------------
+ * The optional files the index is written to and read from.  An empty
+ * path means the corresponding file isn't used.
+ */
+  struct IndexPaths {
+    std::string stats; // Receives index statistics as JSON.
+    std::string load; // A saved snapshot to map instead of crawling.
+    std::string save; // Where to save the snapshot after crawling.
+    std::string queryLog; // Records each search term, and picks the terms to warm up.
+    std::string seenItems; // Records the GUIDs and links of indexed items, so a crawl extending the saved index skips them.
+    std::string frontier; // Logs pending feeds and articles, so an interrupted crawl resumes in priority order.
+    std::string feedCache; // Holds the parsed feed list and feeds, so unchanged ones aren't parsed again.
+  };
   
   NewsAggregatorLog log;
   std::string rssFeedListURI;
-  RSSIndex index;
+  CrawlOptions crawlOptions;
+  IndexPaths paths;
+  ConcurrentRSSIndex index;
+  std::atomic<const IndexSnapshot *> snapshot{nullptr}; // What queries run against, under an EpochReclaimer::Guard.
+  mutable std::mutex snapshotOwnerLock; // Serializes publishSnapshot, and guards replacedSnapshots.
+  std::shared_ptr<const IndexSnapshot> snapshotOwner; // Keeps the published snapshot alive.
+  std::deque<std::shared_ptr<const IndexSnapshot>> replacedSnapshots; // The last few replaced, oldest first, so their cursors still resume.
+  TokenNormalizer normalizer;
+  std::unique_ptr<HttpFetcher> fetcher; // Downloads every http and https article, multiplexed if crawlOptions.http2 is set.
+  BodyTokenCache bodyCache; // Token counts of recently seen article bodies, so duplicates skip the parse.
   bool built = false;
+  bool extendingIndex = false; // Set when a loaded index seeds the one the crawl builds.
+  FeedRefreshScheduler refreshScheduler; // Declared before the pools, which its timers and polls run on.
+  std::mutex refreshLock; // Lets one refresh at a time use the article pool and intermediate index.
+  std::thread crawlThread; // Runs the crawl when querying while crawling.
   ThreadPool feedPool;
   ThreadPool articlePool;
   static const size_t kMagicThreadingNumber = 51122153;
@@ -86,9 +157,31 @@ class NewsAggregator {
   // This set stores the full URLs that have been used already.
   std::set<std::string> seenURLs;
 
+  // The feeds and articles waiting to be fetched, highest priority first.
+  CrawlFrontier frontier;
+
+  // What the feed list and each feed last parsed to (used only if paths.feedCache is set).
+  FeedCache feedCache;
+
+  // The GUIDs and canonical links of every feed item claimed so far, this run or (via paths.seenItems) earlier ones.
+  SeenItemSet seenItems;
+
   // This monstrosity of a map is used to store articles before they are entered into the index.
-  // It maps a pair (article title, domain) to a pair (Article object, vector of tokens).
-  std::map<std::pair<std::string, std::string>, std::pair<Article, std::vector<std::string>>> intermediateIndex;
+  // It maps a pair (article title, domain) to a pair (Article object, ID-sorted token counts).
+  std::map<std::pair<std::string, std::string>, ConcurrentRSSIndex::ArticleTokenCounts> intermediateIndex;
+
+  // The (article title, domain) pairs of every article already added to the index, so that a refresh
+  // doesn't add one again under another URL (guarded by intermediateIndexLock).
+  std::set<std::pair<std::string, std::string>> indexedArticles;
+
+  // While querying during the initial crawl, the intermediate entries added or revised since the last
+  // partial snapshot (guarded by intermediateIndexLock), and those already published (touched only by
+  // whoever holds publishLock).  Both are emptied once the crawl is done.
+  typedef std::map<std::pair<std::string, std::string>, std::shared_ptr<const ConcurrentRSSIndex::ArticleTokenCounts>> PartialIndex;
+  std::atomic<bool> publishingPartialIndex{false};
+  std::mutex publishLock;
+  PartialIndex unpublishedArticles;
+  PartialIndex publishedArticles;
   
   
   
@@ -98,34 +191,136 @@ class NewsAggregator {
  * ---------------------------
  * Private constructor used exclusively by the createNewsAggregator function
  * (and no one else) to construct a NewsAggregator around the supplied URI.
+ * The normalizer options are applied to article tokens and search terms alike.
  */
-  NewsAggregator(const std::string& rssFeedListURI, bool verbose);
+  NewsAggregator(const std::string& rssFeedListURI, bool verbose, const TokenNormalizer::Options& normalizerOptions,
+                 const CrawlOptions& crawlOptions, const IndexPaths& paths);
+
+/**
+ * Method: loadIndex
+ * -----------------
+ * Maps the saved snapshot named by paths.load and prefaults its dictionary
+ * and hottest postings on the article pool.  If paths.seenItems is set,
+ * the loaded articles also seed the index, and extendingIndex is set.
+ * Returns false if it couldn't be loaded, in which case the index should
+ * be built from scratch.
+ */
+  bool loadIndex();
+
+/**
+ * Method: writeIndexStats
+ * -----------------------
+ * Computes statistics over the finished snapshot and writes them to paths.stats as JSON.
+ */
+  void writeIndexStats() const;
+
+/**
+ * Method: crawl
+ * -------------
+ * Crawls every feed in the list, then publishes and saves the resulting index.
+ */
+  void crawl();
 
 /**
  * Method: processAllFeeds
  * -----------------------
- * Calls launchFeedPool to downloads all of the feeds and news articles.
- * Builds the final index once the article pool has updated the intermediate index.
+ * Streams the feed list, scheduling each feed on the feed pool as soon as
+ * it's read, so feeds are downloaded while the rest of the list is parsed.
+ * Prunes overly common terms, then builds the final index once the article
+ * pool has updated the intermediate index, handing it over in a single batch.
  */
   void processAllFeeds();
 
 /**
- * Method: launchFeedPool
+ * Method: schedulePartialPublishing
+ * ---------------------------------
+ * Arranges for publishPartialIndex to run on the feed pool after the supplied
+ * delay, and (until the crawl is done) to keep running at intervals that give
+ * the crawl at least four times as long as each publication takes.
+ */
+  void schedulePartialPublishing(std::chrono::steady_clock::duration delay);
+
+/**
+ * Method: publishPartialIndex
+ * ---------------------------
+ * Publishes a snapshot of every article crawled so far for queries to pick
+ * up, without blocking the article pool while it's built.  The terms pruned
+ * at the end of the crawl are still present.
+ */
+  void publishPartialIndex();
+
+/**
+ * Method: publishSnapshot
  * -----------------------
- * Accepts a map of feed URLs and titles as extracted from a feed list.
- * Launches a pool of workers that populate the articles vector.
- * Calls launchArticlePool for each processed feed.
+ * Publishes the supplied snapshot for queries to pick up, without making them
+ * wait on any lock.  The last few snapshots it replaces are kept so their
+ * page tokens still resume; older ones are retired to the EpochReclaimer, and
+ * freed once no query can still be reading them.
+ */
+  void publishSnapshot(const std::shared_ptr<const IndexSnapshot>& next);
+
+/**
+ * Method: findSnapshot
+ * --------------------
+ * Returns the published or recently replaced snapshot with the supplied
+ * generation, so a page token resumes on the snapshot that issued it, or
+ * null if that snapshot has since been retired.
+ */
+  std::shared_ptr<const IndexSnapshot> findSnapshot(uint64_t generation) const;
+
+/**
+ * Method: isRefreshing
+ * --------------------
+ * Returns true if feeds should keep being polled after the initial crawl.
  */
-  void launchFeedPool(const std::map<std::string, std::string>& feeds);
+  bool isRefreshing() const { return crawlOptions.freshnessTarget > 0; }
+
+/**
+ * Method: refreshFeed
+ * -------------------
+ * Polls the supplied feed on behalf of the refresh scheduler, indexes any
+ * items no feed has claimed yet, and populates items with everything the
+ * feed lists.  Returns false if the feed couldn't be fetched.
+ */
+  bool refreshFeed(const std::string& feedURL, std::vector<FeedItem>& items);
+
+/**
+ * Method: indexRefreshedItems
+ * ---------------------------
+ * Downloads the supplied new items on the article pool, adds them to the
+ * index (less any terms pruned after the initial crawl), and publishes a
+ * new snapshot for queries to pick up.
+ */
+  void indexRefreshedItems(const std::vector<FeedItem>& items);
+
+/**
+ * Method: scheduleFeeds
+ * ---------------------
+ * Schedules the supplied number of feed pool workers, each of which fetches
+ * the highest-priority feed in the frontier.  Calls launchArticlePool for
+ * each processed feed, passing along only the items no other feed has claimed.
+ */
+  void scheduleFeeds(size_t numFeeds);
 
 /**
  * Method: launchArticlePool
  * -----------------------
- * Accepts a vector of articles as extracted from a feed.
- * Launches a pool of workers that populate the intermediate index.
- * Handles duplicate URLs and same article at different URLs.
+ * Accepts a vector of new (already claimed) items as extracted from a feed,
+ * adds them to the frontier, and waits for the article pool to fetch them.
+ */
+  void launchArticlePool(const std::vector<FeedItem>& items);
+
+/**
+ * Method: scheduleArticles
+ * ------------------------
+ * Schedules one article pool worker per supplied host, each of which fetches
+ * the highest-priority article in the frontier from its host (or any host,
+ * if it's empty or has nothing left) and populates the intermediate index.
+ * Hosts are ignored unless crawlOptions.hostAffinity is set, in which case
+ * workers for one host also favor one thread.  Handles duplicate URLs and
+ * same article at different URLs.
  */
-  void launchArticlePool(const std::vector<Article>& articles);
+  void scheduleArticles(const std::vector<std::string>& hosts);
 
 /**
  * Copy Constructor, Assignment Operator
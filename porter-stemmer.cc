@@ -0,0 +1,215 @@
+/**
+ * File: porter-stemmer.cc
+ * -----------------------
+ * Presents the implementation of porterStem, a direct port of Martin Porter's
+ * reference implementation.  The word lives in b[0..k], and j is the scratch
+ * offset set by ends() that the individual steps measure against.
+ */
+
+#include "porter-stemmer.h"
+
+#include <cstring>
+using namespace std;
+
+namespace {
+
+class PorterStemmer {
+ public:
+  PorterStemmer(string& word) : b(word), k(int(word.size()) - 1), j(0) {}
+
+  void stem() {
+    if (k <= 1) return;
+    step1ab();
+    if (k > 0) {
+      step1c();
+      step2();
+      step3();
+      step4();
+      step5();
+    }
+    b.resize(k + 1);
+  }
+
+ private:
+  string& b;
+  int k;
+  int j;
+
+  // True if b[i] is a consonant.  'y' is a consonant only when it follows a vowel.
+  bool cons(int i) const {
+    switch (b[i]) {
+      case 'a': case 'e': case 'i': case 'o': case 'u': return false;
+      case 'y': return i == 0 ? true : !cons(i - 1);
+      default: return true;
+    }
+  }
+
+  // Counts the VC sequences in b[0..j]: <c>(vc)^m<v>.
+  int m() const {
+    int n = 0;
+    int i = 0;
+    while (true) {
+      if (i > j) return n;
+      if (!cons(i)) break;
+      i++;
+    }
+    i++;
+    while (true) {
+      while (true) {
+        if (i > j) return n;
+        if (cons(i)) break;
+        i++;
+      }
+      i++;
+      n++;
+      while (true) {
+        if (i > j) return n;
+        if (!cons(i)) break;
+        i++;
+      }
+      i++;
+    }
+  }
+
+  bool vowelInStem() const {
+    for (int i = 0; i <= j; i++) {
+      if (!cons(i)) return true;
+    }
+    return false;
+  }
+
+  bool doubleConsonant(int i) const {
+    return i >= 1 && b[i] == b[i - 1] && cons(i);
+  }
+
+  // True if b[i-2..i] is consonant-vowel-consonant and the last one isn't w, x or y.
+  bool cvc(int i) const {
+    if (i < 2 || !cons(i) || cons(i - 1) || !cons(i - 2)) return false;
+    char ch = b[i];
+    return ch != 'w' && ch != 'x' && ch != 'y';
+  }
+
+  bool ends(const char *suffix) {
+    int length = strlen(suffix);
+    if (length > k + 1) return false;
+    if (b.compare(k - length + 1, length, suffix) != 0) return false;
+    j = k - length;
+    return true;
+  }
+
+  void setTo(const char *replacement) {
+    int length = strlen(replacement);
+    b.replace(j + 1, k - j, replacement);
+    k = j + length;
+  }
+
+  void replaceIfMeasured(const char *replacement) {
+    if (m() > 0) setTo(replacement);
+  }
+
+  // Removes plurals and -ed or -ing.
+  void step1ab() {
+    if (b[k] == 's') {
+      if (ends("sses")) k -= 2;
+      else if (ends("ies")) setTo("i");
+      else if (b[k - 1] != 's') k--;
+    }
+    if (ends("eed")) {
+      if (m() > 0) k--;
+    } else if ((ends("ed") || ends("ing")) && vowelInStem()) {
+      k = j;
+      if (ends("at")) setTo("ate");
+      else if (ends("bl")) setTo("ble");
+      else if (ends("iz")) setTo("ize");
+      else if (doubleConsonant(k)) {
+        k--;
+        char ch = b[k];
+        if (ch == 'l' || ch == 's' || ch == 'z') k++;
+      } else if (m() == 1 && cvc(k)) {
+        setTo("e");
+      }
+    }
+  }
+
+  // Turns a terminal y into i when there is another vowel in the stem.
+  void step1c() {
+    if (ends("y") && vowelInStem()) b[k] = 'i';
+  }
+
+  // Maps double suffixes to single ones: -ization becomes -ize, and so on.
+  void step2() {
+    static const char *const kRules[][2] = {
+      {"ational", "ate"}, {"tional", "tion"}, {"enci", "ence"}, {"anci", "ance"},
+      {"izer", "ize"}, {"bli", "ble"}, {"alli", "al"}, {"entli", "ent"},
+      {"eli", "e"}, {"ousli", "ous"}, {"ization", "ize"}, {"ation", "ate"},
+      {"ator", "ate"}, {"alism", "al"}, {"iveness", "ive"}, {"fulness", "ful"},
+      {"ousness", "ous"}, {"aliti", "al"}, {"iviti", "ive"}, {"biliti", "ble"},
+      {"logi", "log"},
+    };
+    if (k < 1) return;
+    for (const auto& rule : kRules) {
+      // Every rule's penultimate letter discriminates, just as the switch does in the reference code.
+      size_t length = strlen(rule[0]);
+      if (rule[0][length - 2] != b[k - 1]) continue;
+      if (ends(rule[0])) {
+        replaceIfMeasured(rule[1]);
+        return;
+      }
+    }
+  }
+
+  // Handles -ic-, -full, -ness and friends.
+  void step3() {
+    static const char *const kRules[][2] = {
+      {"icate", "ic"}, {"ative", ""}, {"alize", "al"}, {"iciti", "ic"},
+      {"ical", "ic"}, {"ful", ""}, {"ness", ""},
+    };
+    for (const auto& rule : kRules) {
+      size_t length = strlen(rule[0]);
+      if (rule[0][length - 1] != b[k]) continue;
+      if (ends(rule[0])) {
+        replaceIfMeasured(rule[1]);
+        return;
+      }
+    }
+  }
+
+  // Strips -ant, -ence and the rest when the stem is long enough (m() > 1).
+  void step4() {
+    static const char *const kSuffixes[] = {
+      "al", "ance", "ence", "er", "ic", "able", "ible", "ant", "ement", "ment",
+      "ent", "ion", "ou", "ism", "ate", "iti", "ous", "ive", "ize",
+    };
+    if (k < 1) return;
+    bool matched = false;
+    for (const char *suffix : kSuffixes) {
+      size_t length = strlen(suffix);
+      if (suffix[length - 2] != b[k - 1]) continue;
+      if (!ends(suffix)) continue;
+      if (strcmp(suffix, "ion") == 0 && !(j >= 0 && (b[j] == 's' || b[j] == 't'))) continue;
+      matched = true;
+      break;
+    }
+    if (matched && m() > 1) k = j;
+  }
+
+  // Removes a final -e and reduces -ll to -l when the stem is long enough.
+  void step5() {
+    j = k;
+    if (b[k] == 'e') {
+      int measure = m();
+      if (measure > 1 || (measure == 1 && !cvc(k - 1))) k--;
+    }
+    if (b[k] == 'l' && doubleConsonant(k) && m() > 1) k--;
+  }
+};
+
+}  // namespace
+
+void porterStem(string& word) {
+  if (word.size() < 3) return;
+  for (char ch : word) {
+    if (ch < 'a' || ch > 'z') return;
+  }
+  PorterStemmer(word).stem();
+}
@@ -0,0 +1,19 @@
+/**
+ * File: porter-stemmer.h
+ * ----------------------
+ * Exports a single function that reduces an English word to its stem
+ * using the classic Porter (1980) suffix-stripping algorithm, so that
+ * "connected", "connecting" and "connection" all index as "connect".
+ */
+
+#pragma once
+#include <string>
+
+/**
+ * Function: porterStem
+ * --------------------
+ * Stems the supplied word in place.  The word is expected to be lowercase
+ * ASCII; anything containing other characters, and anything shorter than
+ * three letters, is left untouched.
+ */
+void porterStem(std::string& word);
@@ -0,0 +1,81 @@
+/**
+ * File: result-cursor.cc
+ * ----------------------
+ * Presents the implementation of the ResultCursor record.  A token is the
+ * fixed-width hex encoding of every field (the term positions last, one
+ * field apiece) followed by a 16-bit checksum, which is enough to reject
+ * tokens that were mistyped or truncated.
+ */
+
+#include "result-cursor.h"
+
+#include <cstdio>
+using namespace std;
+
+// Every fixed field, then the number of terms, then one field per term, then the checksum.
+static const size_t kFixedLength = 16 + 8 + 8 + 8 + 8 + 2;
+static const size_t kTermLength = 8;
+static const size_t kChecksumLength = 4;
+
+static uint16_t checksum(const string& payload) {
+  uint32_t sum = 0;
+  for (unsigned char ch : payload) sum = (sum * 31 + ch) % 65521;
+  return sum;
+}
+
+string ResultCursor::encode() const {
+  char buffer[kFixedLength + 1];
+  snprintf(buffer, sizeof(buffer), "%016llx%08x%08x%08x%08x%02x", (unsigned long long) generation,
+           serverIndex, (uint32_t) lastCount, lastArticleID, numShown, (unsigned) termIndices.size());
+  string payload(buffer, kFixedLength);
+  for (uint32_t termIndex : termIndices) {
+    snprintf(buffer, sizeof(buffer), "%08x", termIndex);
+    payload += buffer;
+  }
+  snprintf(buffer, sizeof(buffer), "%04x", checksum(payload));
+  return payload + buffer;
+}
+
+static bool parseHex(const string& token, size_t start, size_t length, uint64_t& value) {
+  value = 0;
+  for (size_t i = start; i < start + length; i++) {
+    char ch = token[i];
+    int digit;
+    if (ch >= '0' && ch <= '9') digit = ch - '0';
+    else if (ch >= 'a' && ch <= 'f') digit = ch - 'a' + 10;
+    else return false;
+    value = (value << 4) | digit;
+  }
+  return true;
+}
+
+bool ResultCursor::decode(const string& token, ResultCursor& cursor) {
+  if (token.size() < kFixedLength + kTermLength + kChecksumLength) return false;
+  uint64_t fields[6];
+  static const size_t kWidths[] = {16, 8, 8, 8, 8, 2};
+  size_t start = 0;
+  for (size_t i = 0; i < 6; i++) {
+    if (!parseHex(token, start, kWidths[i], fields[i])) return false;
+    start += kWidths[i];
+  }
+  size_t numTerms = fields[5];
+  if (numTerms == 0 || numTerms > kMaxTerms) return false;
+  size_t payloadLength = kFixedLength + numTerms * kTermLength;
+  if (token.size() != payloadLength + kChecksumLength) return false;
+  vector<uint32_t> termIndices(numTerms);
+  for (size_t i = 0; i < numTerms; i++, start += kTermLength) {
+    uint64_t termIndex;
+    if (!parseHex(token, start, kTermLength, termIndex)) return false;
+    termIndices[i] = termIndex;
+  }
+  uint64_t sum;
+  if (!parseHex(token, payloadLength, kChecksumLength, sum) || sum != checksum(token.substr(0, payloadLength))) return false;
+
+  cursor.generation = fields[0];
+  cursor.serverIndex = fields[1];
+  cursor.lastCount = (int32_t) (uint32_t) fields[2];
+  cursor.lastArticleID = fields[3];
+  cursor.numShown = fields[4];
+  cursor.termIndices.swap(termIndices);
+  return true;
+}
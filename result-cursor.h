@@ -0,0 +1,43 @@
+/**
+ * File: result-cursor.h
+ * ---------------------
+ * Defines the ResultCursor record, which remembers where a page of query
+ * results left off: the snapshot it was computed against, the query (its
+ * terms and any server it was restricted to), and the score and article ID
+ * of the last match shown.  Cursors travel to the user as
+ * opaque hex tokens, so the next page can be resumed without keeping any
+ * per-query state around (though a snapshot caches the ranked matches of
+ * the few multi-term queries most recently resumed).
+ */
+
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+
+struct ResultCursor {
+  static const uint32_t kNoServer = UINT32_MAX;
+  static const size_t kMaxTerms = 0xff; // Queries with more terms than this can't be resumed.
+
+  uint64_t generation = 0; // Generation of the snapshot the cursor belongs to.
+  std::vector<uint32_t> termIndices; // Positions of the query's terms in that snapshot's dictionary.
+  uint32_t serverIndex = kNoServer; // Position of the server the query was restricted to, if any.
+  int32_t lastCount = 0; // Score of the last match shown.
+  uint32_t lastArticleID = 0; // ID of the last match shown, which breaks ties.
+  uint32_t numShown = 0; // Number of matches shown so far, used only for display.
+
+/**
+ * Method: encode
+ * --------------
+ * Returns the cursor as a compact, opaque token.
+ */
+  std::string encode() const;
+
+/**
+ * Static Method: decode
+ * ---------------------
+ * Parses a token produced by encode.  Returns false if the token is
+ * malformed or fails its checksum, in which case cursor is untouched.
+ */
+  static bool decode(const std::string& token, ResultCursor& cursor);
+};
@@ -0,0 +1,88 @@
+/**
+ * File: seen-item-set.cc
+ * ----------------------
+ * Presents the implementation of the SeenItemSet class.
+ */
+
+#include "seen-item-set.h"
+
+#include <fstream>
+using namespace std;
+
+/**
+ * Function: getGUIDKey
+ * --------------------
+ * GUIDs that are URLs (or URNs and tag URIs) are unique everywhere, but plain
+ * ones like "123" are often unique only within one feed, so those are scoped
+ * by the host of the item's canonical link.
+ */
+static string getGUIDKey(const FeedItem& item) {
+  if (item.guid.empty()) return "";
+  if (item.guid.find("://") != string::npos || item.guid.compare(0, 4, "urn:") == 0 ||
+      item.guid.compare(0, 4, "tag:") == 0) {
+    return "guid " + item.guid;
+  }
+  string host = item.canonicalURL.substr(0, item.canonicalURL.find_first_of("/?"));
+  return "guid " + host + " " + item.guid;
+}
+
+static string getLinkKey(const FeedItem& item) {
+  return "link " + item.canonicalURL;
+}
+
+bool SeenItemSet::insert(const string& key) {
+  Stripe& stripe = stripes[hash<string>()(key) % kNumStripes];
+  lock_guard<mutex> lg(stripe.lock);
+  return stripe.keys.insert(key).second;
+}
+
+void SeenItemSet::erase(const string& key) {
+  Stripe& stripe = stripes[hash<string>()(key) % kNumStripes];
+  lock_guard<mutex> lg(stripe.lock);
+  stripe.keys.erase(key);
+}
+
+size_t SeenItemSet::load(const string& path) {
+  ifstream in(path);
+  size_t numRead = 0;
+  string key;
+  while (getline(in, key)) {
+    if (key.empty()) continue;
+    insert(key);
+    numRead++;
+  }
+  return numRead;
+}
+
+bool SeenItemSet::claim(const FeedItem& item) {
+  string guidKey = getGUIDKey(item);
+  bool isNewGUID = guidKey.empty() || insert(guidKey);
+  bool isNewLink = insert(getLinkKey(item));
+  return isNewGUID && isNewLink;
+}
+
+void SeenItemSet::release(const FeedItem& item) {
+  string guidKey = getGUIDKey(item);
+  if (!guidKey.empty()) erase(guidKey);
+  erase(getLinkKey(item));
+}
+
+void SeenItemSet::recordIndexed(const FeedItem& item) {
+  string guidKey = getGUIDKey(item);
+  string linkKey = getLinkKey(item);
+  lock_guard<mutex> lg(unsavedLock);
+  // Keys are stored one per line, so a key with a line break in it can't be.
+  if (!guidKey.empty() && guidKey.find('\n') == string::npos) unsaved.push_back(guidKey);
+  if (linkKey.find('\n') == string::npos) unsaved.push_back(linkKey);
+}
+
+bool SeenItemSet::save(const string& path) {
+  lock_guard<mutex> lg(unsavedLock);
+  ofstream out(path, ios::app);
+  if (!out) return false;
+  for (const string& key : unsaved) out << key << '\n';
+  out.flush();
+  if (!out) return false;
+  unsaved.clear();
+  return true;
+}
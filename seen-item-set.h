@@ -0,0 +1,82 @@
+/**
+ * File: seen-item-set.h
+ * ---------------------
+ * Defines the SeenItemSet class, the set of feed items (by GUID and by
+ * canonical link) the aggregator has already claimed.  GUIDs that aren't
+ * URLs are only unique within their site, so they're keyed with its host.  Claiming is how the
+ * article pool avoids scheduling a second download of the same item, whether
+ * it turns up again in another feed or under another URL.
+ *
+ * Items that actually make it into the index can also be recorded in a file,
+ * one key per line, so that later runs skip them before fetching anything.
+ * Like the TokenDictionary, the set is split into independently locked stripes.
+ */
+
+#pragma once
+#include <array>
+#include <mutex>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+#include "feed-document.h"
+
+class SeenItemSet {
+ public:
+/**
+ * Method: load
+ * ------------
+ * Adds every key recorded in the supplied file by earlier runs.  A missing
+ * file is simply an empty one.  Returns the number of keys read.
+ */
+  size_t load(const std::string& path);
+
+/**
+ * Method: claim
+ * -------------
+ * Claims the supplied item for this run.  Returns true if neither its GUID
+ * nor its canonical link has been seen before, and false if it's a duplicate.
+ * Either way, both keys are remembered from then on.  Safe to call from any thread.
+ */
+  bool claim(const FeedItem& item);
+
+/**
+ * Method: release
+ * ---------------
+ * Forgets the keys of the supplied claimed item, whose download failed, so
+ * that a later poll that lists it again can claim it and retry.  Safe to
+ * call from any thread.
+ */
+  void release(const FeedItem& item);
+
+/**
+ * Method: recordIndexed
+ * ---------------------
+ * Notes that the supplied (claimed) item made it into the index, so that
+ * the next call to save writes it out.  Safe to call from any thread.
+ */
+  void recordIndexed(const FeedItem& item);
+
+/**
+ * Method: save
+ * ------------
+ * Appends the keys of every item recorded since the last save to the
+ * supplied file.  Returns false if the file couldn't be written.
+ */
+  bool save(const std::string& path);
+
+ private:
+  static const size_t kNumStripes = 64;
+
+  struct alignas(64) Stripe {
+    std::mutex lock;
+    std::unordered_set<std::string> keys;
+  };
+
+  std::array<Stripe, kNumStripes> stripes;
+  std::mutex unsavedLock;
+  std::vector<std::string> unsaved;
+
+  bool insert(const std::string& key);
+  void erase(const std::string& key);
+};
@@ -0,0 +1,76 @@
+/**
+ * File: semaphore-ping-pong.cc
+ * ----------------------------
+ * A standalone driver that measures the handoff latency of FastSemaphore
+ * against the mutex-and-condition-variable semaphore it replaces.  Two
+ * threads bounce a token back and forth through a pair of semaphores, so
+ * that every wait finds its signal either on its way (where FastSemaphore
+ * spins) or not yet sent (where both have to sleep), and the driver reports
+ * the average round trip.  It finishes by repeatedly destroying a
+ * FastSemaphore as soon as its one wait returns, the way the HttpFetcher
+ * does, to show that a signal never touches a destroyed semaphore.
+ *
+ * Usage: semaphore-ping-pong [<round-trips>]
+ */
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <thread>
+
+#include "fast-semaphore.h"
+#include "semaphore.h"
+using namespace std;
+
+static const size_t kDefaultNumRoundTrips = 200000;
+static const size_t kNumOneShotSemaphores = 2000;
+
+// Returns the average round trip, in microseconds, of a token passed between two threads.
+template <typename Semaphore>
+static double timeRoundTrips(size_t numRoundTrips) {
+  Semaphore ping, pong;
+  thread partner([&] {
+    for (size_t i = 0; i < numRoundTrips; i++) {
+      ping.wait();
+      pong.signal();
+    }
+  });
+  chrono::steady_clock::time_point start = chrono::steady_clock::now();
+  for (size_t i = 0; i < numRoundTrips; i++) {
+    ping.signal();
+    pong.wait();
+  }
+  double elapsed = chrono::duration<double, micro>(chrono::steady_clock::now() - start).count();
+  partner.join();
+  return elapsed / numRoundTrips;
+}
+
+static void destroyAfterWait(size_t numSemaphores) {
+  for (size_t i = 0; i < numSemaphores; i++) {
+    FastSemaphore *finished = new FastSemaphore;
+    thread signaler([finished] { finished->signal(); });
+    finished->wait();
+    delete finished;
+    signaler.join();
+  }
+}
+
+int main(int argc, char *argv[]) {
+  size_t numRoundTrips = kDefaultNumRoundTrips;
+  if (argc > 2) {
+    cerr << "Usage: " << argv[0] << " [<round-trips>]" << endl;
+    return 1;
+  }
+  if (argc == 2) numRoundTrips = strtoul(argv[1], NULL, 10);
+  if (numRoundTrips == 0) {
+    cerr << "The number of round trips must be positive." << endl;
+    return 1;
+  }
+
+  cout << numRoundTrips << " round trips between two threads:" << endl;
+  cout << "  semaphore:     " << timeRoundTrips<semaphore>(numRoundTrips) << " us per round trip" << endl;
+  cout << "  FastSemaphore: " << timeRoundTrips<FastSemaphore>(numRoundTrips) << " us per round trip" << endl;
+  destroyAfterWait(kNumOneShotSemaphores);
+  cout << kNumOneShotSemaphores << " FastSemaphores destroyed as soon as their waits returned." << endl;
+  return 0;
+}
@@ -0,0 +1,189 @@
+/**
+ * File: sorted-intersection.cc
+ * ----------------------------
+ * Presents the implementation of the sorted-list intersection kernels.
+ *
+ * The block kernels load a block of each list and compare every element of
+ * one block against every element of the other by comparing against each
+ * rotation of the second block.  Whichever block has the smaller maximum can
+ * hold no further matches, so it's retired (both are, on a tie).  Matches are
+ * rare relative to comparisons, so they're extracted from the bit masks with
+ * a short scalar loop.
+ */
+
+#include "sorted-intersection.h"
+
+#include <algorithm>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define HAVE_X86_KERNELS 1
+#endif
+using namespace std;
+
+// Beyond this size ratio, galloping beats a linear merge of any width.
+static const size_t kGallopRatio = 32;
+
+typedef size_t (*KernelFunction)(const uint32_t *, size_t, const uint32_t *, size_t, uint32_t *, uint32_t *);
+
+static size_t mergeTail(const uint32_t *a, size_t i, size_t aLength, const uint32_t *b, size_t j, size_t bLength,
+                        uint32_t *aPositions, uint32_t *bPositions, size_t count) {
+  while (i < aLength && j < bLength) {
+    if (a[i] < b[j]) {
+      i++;
+    } else if (b[j] < a[i]) {
+      j++;
+    } else {
+      aPositions[count] = i++;
+      bPositions[count] = j++;
+      count++;
+    }
+  }
+  return count;
+}
+
+// Every element of small is located in large with an exponential search that starts where the last one ended.
+static size_t intersectGalloping(const uint32_t *small, size_t smallLength, const uint32_t *large, size_t largeLength,
+                                 uint32_t *smallPositions, uint32_t *largePositions) {
+  size_t count = 0;
+  size_t low = 0;
+  for (size_t i = 0; i < smallLength && low < largeLength; i++) {
+    uint32_t value = small[i];
+    size_t step = 1;
+    while (low + step < largeLength && large[low + step] < value) step *= 2;
+    size_t high = min(low + step + 1, largeLength);
+    low = lower_bound(large + low + step / 2, large + high, value) - large;
+    if (low < largeLength && large[low] == value) {
+      smallPositions[count] = i;
+      largePositions[count] = low;
+      count++;
+    }
+  }
+  return count;
+}
+
+static size_t intersectScalar(const uint32_t *a, size_t aLength, const uint32_t *b, size_t bLength,
+                              uint32_t *aPositions, uint32_t *bPositions) {
+  return mergeTail(a, 0, aLength, b, 0, bLength, aPositions, bPositions, 0);
+}
+
+#ifdef HAVE_X86_KERNELS
+static size_t intersectSSE2(const uint32_t *a, size_t aLength, const uint32_t *b, size_t bLength,
+                            uint32_t *aPositions, uint32_t *bPositions) {
+  size_t i = 0, j = 0, count = 0;
+  while (i + 4 <= aLength && j + 4 <= bLength) {
+    __m128i va = _mm_loadu_si128(reinterpret_cast<const __m128i *>(a + i));
+    __m128i vb = _mm_loadu_si128(reinterpret_cast<const __m128i *>(b + j));
+    // Lane k of rotation r holds b[j + (k + r) % 4].
+    int masks[4];
+    masks[0] = _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(va, vb)));
+    masks[1] = _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(va, _mm_shuffle_epi32(vb, _MM_SHUFFLE(0, 3, 2, 1)))));
+    masks[2] = _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(va, _mm_shuffle_epi32(vb, _MM_SHUFFLE(1, 0, 3, 2)))));
+    masks[3] = _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(va, _mm_shuffle_epi32(vb, _MM_SHUFFLE(2, 1, 0, 3)))));
+    int matched = masks[0] | masks[1] | masks[2] | masks[3];
+    while (matched != 0) {
+      int lane = __builtin_ctz(matched);
+      matched &= matched - 1;
+      int rotation = 0;
+      while (!(masks[rotation] & (1 << lane))) rotation++;
+      aPositions[count] = i + lane;
+      bPositions[count] = j + ((lane + rotation) & 3);
+      count++;
+    }
+    uint32_t aMax = a[i + 3], bMax = b[j + 3];
+    if (aMax <= bMax) i += 4;
+    if (bMax <= aMax) j += 4;
+  }
+  return mergeTail(a, i, aLength, b, j, bLength, aPositions, bPositions, count);
+}
+
+__attribute__((target("avx2")))
+static size_t intersectAVX2(const uint32_t *a, size_t aLength, const uint32_t *b, size_t bLength,
+                            uint32_t *aPositions, uint32_t *bPositions) {
+  const __m256i rotations[8] = {
+    _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7), _mm256_setr_epi32(1, 2, 3, 4, 5, 6, 7, 0),
+    _mm256_setr_epi32(2, 3, 4, 5, 6, 7, 0, 1), _mm256_setr_epi32(3, 4, 5, 6, 7, 0, 1, 2),
+    _mm256_setr_epi32(4, 5, 6, 7, 0, 1, 2, 3), _mm256_setr_epi32(5, 6, 7, 0, 1, 2, 3, 4),
+    _mm256_setr_epi32(6, 7, 0, 1, 2, 3, 4, 5), _mm256_setr_epi32(7, 0, 1, 2, 3, 4, 5, 6),
+  };
+  size_t i = 0, j = 0, count = 0;
+  while (i + 8 <= aLength && j + 8 <= bLength) {
+    __m256i va = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(a + i));
+    __m256i vb = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(b + j));
+    int masks[8];
+    int matched = 0;
+    for (int rotation = 0; rotation < 8; rotation++) {
+      __m256i rotated = _mm256_permutevar8x32_epi32(vb, rotations[rotation]);
+      masks[rotation] = _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpeq_epi32(va, rotated)));
+      matched |= masks[rotation];
+    }
+    while (matched != 0) {
+      int lane = __builtin_ctz(matched);
+      matched &= matched - 1;
+      int rotation = 0;
+      while (!(masks[rotation] & (1 << lane))) rotation++;
+      aPositions[count] = i + lane;
+      bPositions[count] = j + ((lane + rotation) & 7);
+      count++;
+    }
+    uint32_t aMax = a[i + 7], bMax = b[j + 7];
+    if (aMax <= bMax) i += 8;
+    if (bMax <= aMax) j += 8;
+  }
+  return mergeTail(a, i, aLength, b, j, bLength, aPositions, bPositions, count);
+}
+#endif
+
+static KernelFunction chooseKernel() {
+#ifdef HAVE_X86_KERNELS
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2")) return intersectAVX2;
+  return intersectSSE2;
+#else
+  return intersectScalar;
+#endif
+}
+
+size_t intersectSortedPositions(const uint32_t *a, size_t aLength, const uint32_t *b, size_t bLength,
+                                uint32_t *aPositions, uint32_t *bPositions) {
+  static const KernelFunction kernel = chooseKernel();
+  if (aLength == 0 || bLength == 0) return 0;
+  if (aLength * kGallopRatio < bLength) return intersectGalloping(a, aLength, b, bLength, aPositions, bPositions);
+  if (bLength * kGallopRatio < aLength) return intersectGalloping(b, bLength, a, aLength, bPositions, aPositions);
+  return kernel(a, aLength, b, bLength, aPositions, bPositions);
+}
+
+bool supportsIntersectionKernel(IntersectionKernel kernel) {
+  switch (kernel) {
+#ifdef HAVE_X86_KERNELS
+    case SSE2Blocks:
+      return true;
+    case AVX2Blocks:
+      __builtin_cpu_init();
+      return __builtin_cpu_supports("avx2");
+#endif
+    case ScalarMerge:
+    case Galloping:
+      return true;
+    default:
+      return false;
+  }
+}
+
+size_t intersectSortedPositionsWith(IntersectionKernel kernel, const uint32_t *a, size_t aLength,
+                                    const uint32_t *b, size_t bLength, uint32_t *aPositions, uint32_t *bPositions) {
+  if (aLength == 0 || bLength == 0) return 0;
+  switch (kernel) {
+#ifdef HAVE_X86_KERNELS
+    case SSE2Blocks:
+      return intersectSSE2(a, aLength, b, bLength, aPositions, bPositions);
+    case AVX2Blocks:
+      return intersectAVX2(a, aLength, b, bLength, aPositions, bPositions);
+#endif
+    case Galloping:
+      if (aLength <= bLength) return intersectGalloping(a, aLength, b, bLength, aPositions, bPositions);
+      return intersectGalloping(b, bLength, a, aLength, bPositions, aPositions);
+    default:
+      return intersectScalar(a, aLength, b, bLength, aPositions, bPositions);
+  }
+}
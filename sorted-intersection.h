@@ -0,0 +1,51 @@
+/**
+ * File: sorted-intersection.h
+ * ---------------------------
+ * Exports intersection kernels for sorted, duplicate-free lists of 32-bit
+ * integers, which is what both posting lists (by article ID) and token runs
+ * (by token ID) boil down to.  Lists of similar size are compared a block at
+ * a time with SIMD all-pairs comparisons (AVX2 when the CPU has it, SSE2
+ * otherwise, chosen once at runtime); when one list is much shorter than the
+ * other, each of its elements gallops through the longer one instead.
+ */
+
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * Function: intersectSortedPositions
+ * ----------------------------------
+ * Intersects the two sorted lists and records, for each common value in
+ * increasing order, its position in a and its position in b, so that
+ * callers with parallel arrays (counts, say) can combine them.  Both
+ * output arrays must have room for min(aLength, bLength) entries.
+ * Returns the number of common values.
+ */
+size_t intersectSortedPositions(const uint32_t *a, size_t aLength, const uint32_t *b, size_t bLength,
+                                uint32_t *aPositions, uint32_t *bPositions);
+
+/**
+ * Type: IntersectionKernel
+ * ------------------------
+ * Names each of the strategies intersectSortedPositions chooses among, so
+ * that they can be measured against one another (see intersection-bench.cc).
+ */
+enum IntersectionKernel { ScalarMerge, SSE2Blocks, AVX2Blocks, Galloping };
+
+/**
+ * Function: supportsIntersectionKernel
+ * ------------------------------------
+ * Returns true if the supplied kernel can run on this CPU.
+ */
+bool supportsIntersectionKernel(IntersectionKernel kernel);
+
+/**
+ * Function: intersectSortedPositionsWith
+ * --------------------------------------
+ * Behaves like intersectSortedPositions, except that it always uses the
+ * supplied kernel, which must be supported, whatever the list sizes.
+ * Galloping walks the shorter list through the longer one.
+ */
+size_t intersectSortedPositionsWith(IntersectionKernel kernel, const uint32_t *a, size_t aLength,
+                                    const uint32_t *b, size_t bLength, uint32_t *aPositions, uint32_t *bPositions);
@@ -0,0 +1,288 @@
+/**
+ * File: text-normalization.cc
+ * ---------------------------
+ * Presents the implementation of the text normalization routines.
+ */
+
+#include "text-normalization.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+using namespace std;
+
+/**
+ * Function: findNonASCII
+ * ----------------------
+ * Returns the position of the first byte at or after start with its high
+ * bit set, or length if there isn't one.
+ */
+static size_t findNonASCII(const char *bytes, size_t start, size_t length) {
+  size_t i = start;
+#if defined(__SSE2__)
+  while (i + 16 <= length) {
+    __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i *>(bytes + i));
+    int highBits = _mm_movemask_epi8(block);
+    if (highBits != 0) return i + __builtin_ctz(highBits);
+    i += 16;
+  }
+#endif
+  while (i < length && (unsigned char) bytes[i] < 0x80) i++;
+  return i;
+}
+
+static void appendUTF8(string& out, uint32_t codePoint) {
+  if (codePoint < 0x80) {
+    out += char(codePoint);
+  } else if (codePoint < 0x800) {
+    out += char(0xC0 | (codePoint >> 6));
+    out += char(0x80 | (codePoint & 0x3F));
+  } else if (codePoint < 0x10000) {
+    out += char(0xE0 | (codePoint >> 12));
+    out += char(0x80 | ((codePoint >> 6) & 0x3F));
+    out += char(0x80 | (codePoint & 0x3F));
+  } else {
+    out += char(0xF0 | (codePoint >> 18));
+    out += char(0x80 | ((codePoint >> 12) & 0x3F));
+    out += char(0x80 | ((codePoint >> 6) & 0x3F));
+    out += char(0x80 | (codePoint & 0x3F));
+  }
+}
+
+bool isValidUTF8(const char *bytes, size_t length) {
+  size_t i = 0;
+  while ((i = findNonASCII(bytes, i, length)) < length) {
+    unsigned char lead = bytes[i];
+    size_t numContinuations;
+    uint32_t codePoint;
+    if (lead >= 0xC2 && lead <= 0xDF) {
+      numContinuations = 1;
+      codePoint = lead & 0x1F;
+    } else if ((lead & 0xF0) == 0xE0) {
+      numContinuations = 2;
+      codePoint = lead & 0x0F;
+    } else if (lead >= 0xF0 && lead <= 0xF4) {
+      numContinuations = 3;
+      codePoint = lead & 0x07;
+    } else {
+      return false;
+    }
+    if (length - i <= numContinuations) return false;
+    for (size_t k = 1; k <= numContinuations; k++) {
+      unsigned char continuation = bytes[i + k];
+      if ((continuation & 0xC0) != 0x80) return false;
+      codePoint = (codePoint << 6) | (continuation & 0x3F);
+    }
+    if (numContinuations == 2 && (codePoint < 0x800 || (codePoint >= 0xD800 && codePoint <= 0xDFFF))) return false;
+    if (numContinuations == 3 && (codePoint < 0x10000 || codePoint > 0x10FFFF)) return false;
+    i += numContinuations + 1;
+  }
+  return true;
+}
+
+void foldASCIICase(char *bytes, size_t length) {
+  size_t i = 0;
+#if defined(__SSE2__)
+  // Bytes at or above 0x80 compare as negative, so they never land in ['A', 'Z'].
+  const __m128i beforeA = _mm_set1_epi8('A' - 1);
+  const __m128i afterZ = _mm_set1_epi8('Z' + 1);
+  const __m128i caseBit = _mm_set1_epi8(0x20);
+  while (i + 16 <= length) {
+    __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i *>(bytes + i));
+    __m128i isUpper = _mm_and_si128(_mm_cmpgt_epi8(block, beforeA), _mm_cmplt_epi8(block, afterZ));
+    block = _mm_or_si128(block, _mm_and_si128(isUpper, caseBit));
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(bytes + i), block);
+    i += 16;
+  }
+#endif
+  for (; i < length; i++) {
+    if (bytes[i] >= 'A' && bytes[i] <= 'Z') bytes[i] |= 0x20;
+  }
+}
+
+/**
+ * Function: foldCodePoint
+ * -----------------------
+ * Simple lowercase mapping for the two-byte Latin, Greek and Cyrillic
+ * blocks.  Every mapping stays within two-byte UTF-8, so folding can
+ * happen in place.
+ */
+static uint32_t foldCodePoint(uint32_t codePoint) {
+  if (codePoint >= 0xC0 && codePoint <= 0xDE && codePoint != 0xD7) return codePoint + 0x20;
+  if (codePoint == 0x178) return 0xFF;
+  if ((codePoint >= 0x100 && codePoint <= 0x12F) || (codePoint >= 0x132 && codePoint <= 0x137) ||
+      (codePoint >= 0x14A && codePoint <= 0x177)) {
+    return codePoint | 1;
+  }
+  if ((codePoint >= 0x139 && codePoint <= 0x148) || (codePoint >= 0x179 && codePoint <= 0x17E)) {
+    return codePoint % 2 == 1 ? codePoint + 1 : codePoint;
+  }
+  if (codePoint >= 0x391 && codePoint <= 0x3A9 && codePoint != 0x3A2) return codePoint + 0x20;
+  if (codePoint >= 0x410 && codePoint <= 0x42F) return codePoint + 0x20;
+  if (codePoint >= 0x400 && codePoint <= 0x40F) return codePoint + 0x50;
+  return codePoint;
+}
+
+static void foldUnicodeCase(char *bytes, size_t length) {
+  size_t i = 0;
+  while ((i = findNonASCII(bytes, i, length)) < length) {
+    unsigned char lead = bytes[i];
+    if ((lead & 0xE0) != 0xC0 || i + 1 >= length) {
+      i++;
+      continue;
+    }
+    uint32_t codePoint = ((lead & 0x1F) << 6) | (bytes[i + 1] & 0x3F);
+    uint32_t folded = foldCodePoint(codePoint);
+    if (folded != codePoint) {
+      bytes[i] = char(0xC0 | (folded >> 6));
+      bytes[i + 1] = char(0x80 | (folded & 0x3F));
+    }
+    i += 2;
+  }
+}
+
+namespace {
+struct NamedEntity {
+  const char *name;
+  uint32_t codePoint;
+};
+}
+
+// Sorted by name so lookups can binary search.
+static const NamedEntity kNamedEntities[] = {
+  {"aacute", 0xE1}, {"acirc", 0xE2}, {"agrave", 0xE0}, {"amp", '&'}, {"apos", '\''},
+  {"aring", 0xE5}, {"atilde", 0xE3}, {"auml", 0xE4}, {"bdquo", 0x201E}, {"bull", 0x2022},
+  {"ccedil", 0xE7}, {"cent", 0xA2}, {"copy", 0xA9}, {"deg", 0xB0}, {"eacute", 0xE9},
+  {"ecirc", 0xEA}, {"egrave", 0xE8}, {"euml", 0xEB}, {"euro", 0x20AC}, {"gt", '>'},
+  {"hellip", 0x2026}, {"iacute", 0xED}, {"icirc", 0xEE}, {"iuml", 0xEF}, {"laquo", 0xAB},
+  {"ldquo", 0x201C}, {"lsquo", 0x2018}, {"lt", '<'}, {"mdash", 0x2014}, {"middot", 0xB7},
+  {"nbsp", 0xA0}, {"ndash", 0x2013}, {"ntilde", 0xF1}, {"oacute", 0xF3}, {"ocirc", 0xF4},
+  {"ouml", 0xF6}, {"pound", 0xA3}, {"quot", '"'}, {"raquo", 0xBB}, {"rdquo", 0x201D},
+  {"reg", 0xAE}, {"rsquo", 0x2019}, {"sbquo", 0x201A}, {"szlig", 0xDF}, {"trade", 0x2122},
+  {"uacute", 0xFA}, {"ucirc", 0xFB}, {"uuml", 0xFC}, {"yen", 0xA5},
+};
+
+static const size_t kMaxEntityLength = 10;
+
+/**
+ * Function: parseReference
+ * ------------------------
+ * Parses the character reference starting at text[start] (which holds the '&').
+ * Returns the number of bytes it spans, or 0 if it isn't a recognized
+ * reference, and populates codePoint with what it stands for.
+ */
+static size_t parseReference(const string& text, size_t start, uint32_t& codePoint) {
+  size_t semicolon = text.find(';', start + 1);
+  if (semicolon == string::npos || semicolon - start - 1 > kMaxEntityLength || semicolon == start + 1) return 0;
+  string name = text.substr(start + 1, semicolon - start - 1);
+
+  if (name[0] == '#') {
+    bool hex = name.size() > 1 && (name[1] == 'x' || name[1] == 'X');
+    size_t digits = hex ? 2 : 1;
+    if (digits >= name.size()) return 0;
+    uint32_t value = 0;
+    for (size_t i = digits; i < name.size(); i++) {
+      char ch = name[i];
+      uint32_t digit;
+      if (ch >= '0' && ch <= '9') digit = ch - '0';
+      else if (hex && ch >= 'a' && ch <= 'f') digit = ch - 'a' + 10;
+      else if (hex && ch >= 'A' && ch <= 'F') digit = ch - 'A' + 10;
+      else return 0;
+      value = value * (hex ? 16 : 10) + digit;
+      if (value > 0x10FFFF) return 0;
+    }
+    if (value == 0 || (value >= 0xD800 && value <= 0xDFFF)) return 0;
+    codePoint = value;
+    return semicolon - start + 1;
+  }
+
+  const NamedEntity *end = kNamedEntities + sizeof(kNamedEntities) / sizeof(kNamedEntities[0]);
+  const NamedEntity *found = lower_bound(kNamedEntities, end, name, [](const NamedEntity& entity, const string& key) {
+    return strcmp(entity.name, key.c_str()) < 0;
+  });
+  if (found == end || name != found->name) return 0;
+  codePoint = found->codePoint;
+  return semicolon - start + 1;
+}
+
+void decodeEntities(string& text) {
+  size_t ampersand = text.find('&');
+  if (ampersand == string::npos) return;
+  string decoded(text, 0, ampersand);
+  decoded.reserve(text.size());
+  size_t i = ampersand;
+  while (i < text.size()) {
+    if (text[i] != '&') {
+      size_t next = text.find('&', i);
+      if (next == string::npos) next = text.size();
+      decoded.append(text, i, next - i);
+      i = next;
+      continue;
+    }
+    uint32_t codePoint;
+    size_t span = parseReference(text, i, codePoint);
+    if (span == 0) {
+      decoded += '&';
+      i++;
+    } else {
+      appendUTF8(decoded, codePoint);
+      i += span;
+    }
+  }
+  text.swap(decoded);
+}
+
+// Code points for Windows-1252 bytes 0x80 through 0x9F; the five undefined ones map to themselves.
+static const uint16_t kWindows1252High[32] = {
+  0x20AC, 0x0081, 0x201A, 0x0192, 0x201E, 0x2026, 0x2020, 0x2021,
+  0x02C6, 0x2030, 0x0160, 0x2039, 0x0152, 0x008D, 0x017D, 0x008F,
+  0x0090, 0x2018, 0x2019, 0x201C, 0x201D, 0x2022, 0x2013, 0x2014,
+  0x02DC, 0x2122, 0x0161, 0x203A, 0x0153, 0x009D, 0x017E, 0x0178,
+};
+
+string transcodeWindows1252(const string& text) {
+  string utf8;
+  utf8.reserve(text.size() + text.size() / 8);
+  size_t i = 0;
+  while (i < text.size()) {
+    size_t nonASCII = findNonASCII(text.data(), i, text.size());
+    utf8.append(text, i, nonASCII - i);
+    if (nonASCII == text.size()) break;
+    unsigned char byte = text[nonASCII];
+    appendUTF8(utf8, byte < 0xA0 ? kWindows1252High[byte - 0x80] : byte);
+    i = nonASCII + 1;
+  }
+  return utf8;
+}
+
+// Leading bytes of the binary formats most often linked in place of an article.
+static const struct {
+  const char *bytes;
+  size_t length;
+} kBinarySignatures[] = {
+  {"%PDF-", 5}, {"PK\x03\x04", 4}, {"\x1F\x8B", 2}, {"\x89PNG", 4}, {"GIF8", 4}, {"\xFF\xD8\xFF", 3},
+  {"OggS", 4}, {"ID3", 3}, {"RIFF", 4}, {"\x7F" "ELF", 4}, {"%!PS", 4},
+};
+static const size_t kMaxBytesToSniff = 1024;
+
+bool looksBinary(const char *bytes, size_t length) {
+  for (const auto& signature : kBinarySignatures) {
+    if (length >= signature.length && memcmp(bytes, signature.bytes, signature.length) == 0) return true;
+  }
+  return memchr(bytes, '\0', min(length, kMaxBytesToSniff)) != NULL;
+}
+
+void normalizeText(string& text) {
+  if (text.empty()) return;
+  bool isASCII = findNonASCII(text.data(), 0, text.size()) == text.size();
+  if (memchr(text.data(), '&', text.size()) != NULL) {
+    decodeEntities(text);
+    isASCII = isASCII && findNonASCII(text.data(), 0, text.size()) == text.size();
+  }
+  foldASCIICase(&text[0], text.size());
+  if (!isASCII) foldUnicodeCase(&text[0], text.size());
+}
@@ -0,0 +1,67 @@
+/**
+ * File: text-normalization.h
+ * --------------------------
+ * Exports the byte-level text normalization routines applied to article text
+ * before it becomes index terms.  Almost all of that text is ASCII, so every
+ * routine scans sixteen bytes at a time with SSE2 and only drops into scalar
+ * code for the bytes that need it: non-ASCII runs, entity references, and
+ * bodies that turn out not to be UTF-8 at all (in which case they're taken
+ * to be Windows-1252, the usual mislabelled culprit, and transcoded).  The
+ * last happens to raw bodies, before they're parsed, since what the parser
+ * hands back is always UTF-8.
+ */
+
+#pragma once
+#include <cstddef>
+#include <string>
+
+/**
+ * Function: isValidUTF8
+ * ---------------------
+ * Returns true if and only if the supplied bytes are well-formed UTF-8
+ * (no overlong forms, surrogates, or code points beyond U+10FFFF).
+ */
+bool isValidUTF8(const char *bytes, size_t length);
+
+/**
+ * Function: foldASCIICase
+ * -----------------------
+ * Lowercases every ASCII letter in place, leaving all other bytes alone.
+ */
+void foldASCIICase(char *bytes, size_t length);
+
+/**
+ * Function: decodeEntities
+ * ------------------------
+ * Replaces numeric character references and the common named entities
+ * (&amp;, &nbsp;, &rsquo; and friends) with their UTF-8 encodings.
+ * Unrecognized references are left as they are.
+ */
+void decodeEntities(std::string& text);
+
+/**
+ * Function: transcodeWindows1252
+ * ------------------------------
+ * Returns the UTF-8 encoding of text in Windows-1252 (a superset of
+ * the printable part of Latin-1).
+ */
+std::string transcodeWindows1252(const std::string& text);
+
+/**
+ * Function: looksBinary
+ * ---------------------
+ * Returns true if the supplied bytes, the start of some body, are plainly
+ * not text: they contain a NUL byte, or open with the signature of a common
+ * binary format (PDF, ZIP, gzip, PNG, GIF, JPEG and the like).
+ */
+bool looksBinary(const char *bytes, size_t length);
+
+/**
+ * Function: normalizeText
+ * -----------------------
+ * Runs the rest of the pipeline on text that's already UTF-8: decodes
+ * entities, and folds case.  Pure ASCII text takes the vector fast path
+ * throughout; non-ASCII runs get simple Unicode case folding for the Latin,
+ * Greek and Cyrillic blocks.
+ */
+void normalizeText(std::string& text);
@@ -6,76 +6,188 @@
 
 #include "thread-pool.h"
 #include "ostreamlock.h"
+#include "futex.h"
+#include "epoch-reclaimer.h"
 
 using namespace std;
 using develop::ThreadPool;
 
 
-ThreadPool::ThreadPool(size_t numThreads) : workerVector(numThreads), nextSpawnID(0), pendingThunks(0), exitFlag(false), workerIsAvailable(numThreads) {
+ThreadPool::ThreadPool(size_t numThreads) : workerVector(numThreads), pendingThunks(0), exitFlag(false), nextTimerSequence(0), timersExitFlag(false) {
   dispatcherThread = thread([this]() { dispatcher(); });
 }
 
 void ThreadPool::schedule(const function<void(void)>& thunk) {
+  enqueue(thunkQueue, thunk, false);
+}
+
+void ThreadPool::schedule(const string& key, const function<void(void)>& thunk) {
+  enqueue(workerVector[hash<string>()(key) % workerVector.size()].affinityQueue, thunk, false);
+}
+
+bool ThreadPool::trySchedule(const function<void(void)>& thunk) {
+  return enqueue(thunkQueue, thunk, true);
+}
+
+bool ThreadPool::enqueue(queue<queuedThunkStruct>& queue, const function<void(void)>& thunk, bool shedIfOverloaded) {
   queueLock.lock();
-  thunkQueue.push(thunk);
+  chrono::steady_clock::time_point now = chrono::steady_clock::now();
+  if (shedIfOverloaded && admissionTarget > chrono::steady_clock::duration::zero() && !thunkQueue.empty()) {
+    // With every worker busy for long stretches, nothing is dequeued to measure by,
+    // so a head of the queue that's been waiting a full interval counts too.
+    bool stalled = now - thunkQueue.front().enqueued > admissionInterval;
+    if (overloaded || stalled) {
+      queueLock.unlock();
+      return false;
+    }
+  }
+  queue.push({thunk, now});
+  numQueued++;
   queueLock.unlock();
 
   pendingThunksLock.lock();
   pendingThunks++;
   pendingThunksLock.unlock();
 
-  newThunkFromScheduler.signal();
+  dispatcherEvents.signal();
+  return true;
+}
+
+void ThreadPool::setAdmissionControl(chrono::steady_clock::duration target, chrono::steady_clock::duration interval) {
+  lock_guard<mutex> lg(queueLock);
+  admissionTarget = target;
+  admissionInterval = interval;
+  firstAboveTarget = chrono::steady_clock::time_point();
+  overloaded = false;
+}
+
+void ThreadPool::recordQueueDelay(chrono::steady_clock::duration delay, chrono::steady_clock::time_point now) {
+  if (admissionTarget <= chrono::steady_clock::duration::zero()) return;
+  if (delay < admissionTarget) {
+    firstAboveTarget = chrono::steady_clock::time_point();
+    overloaded = false;
+  } else if (firstAboveTarget == chrono::steady_clock::time_point()) {
+    firstAboveTarget = now + admissionInterval;
+  } else if (now >= firstAboveTarget) {
+    overloaded = true;
+  }
+}
+
+void ThreadPool::scheduleAfter(chrono::steady_clock::duration delay, const function<void(void)>& thunk,
+                               const function<void(void)>& onRejected) {
+  lock_guard<mutex> lg(timersLock);
+  if (timersExitFlag) return; // The pool is being destroyed, so the timer could never fire.
+  if (!timerThread.joinable()) timerThread = thread([this]() { timekeeper(); });
+  timerQueue.push({chrono::steady_clock::now() + delay, nextTimerSequence++, thunk, onRejected});
+  timersCondVar.notify_one();
+}
+
+void ThreadPool::timekeeper() {
+  unique_lock<mutex> timersLockAdapter(timersLock);
+  while (!timersExitFlag) {
+    if (timerQueue.empty()) {
+      timersCondVar.wait(timersLockAdapter);
+      continue;
+    }
+    if (chrono::steady_clock::now() < timerQueue.top().deadline) {
+      // Wakes early if a sooner timer is set or the pool is being destroyed.
+      timersCondVar.wait_until(timersLockAdapter, timerQueue.top().deadline);
+      continue;
+    }
+    function<void(void)> expiredThunk = timerQueue.top().timerThunk;
+    function<void(void)> onRejected = timerQueue.top().onRejected;
+    timerQueue.pop();
+    timersLockAdapter.unlock();
+    if (!onRejected) schedule(expiredThunk);
+    else if (!trySchedule(expiredThunk)) onRejected();
+    timersLockAdapter.lock();
+  }
 }
 
 void ThreadPool::dispatcher() {
   while (true) {
-    newThunkFromScheduler.wait();
-    workerIsAvailable.wait();
+    dispatcherEvents.wait();
 
     if (exitFlag) {
       break;
     }
 
-    int availableWorkerID = -1;
-    workersLock.lock();
-    for (size_t candidateWorkerID = 0; candidateWorkerID < workerVector.size(); candidateWorkerID++) {
-      // If we hit the next Spawn ID, all existing workers were busy. Fire up a new one.
-      if (candidateWorkerID == nextSpawnID) {
-        nextSpawnIDLock.lock();
-        workerVector[nextSpawnID].workerThread = thread(&ThreadPool::worker, this, nextSpawnID);
-        nextSpawnID++;
-        nextSpawnIDLock.unlock();
-      }
-      // Select a free worker, which may or may not have just been spawned.
-      if (!workerVector[candidateWorkerID].workerInUse) {
-        workerVector[candidateWorkerID].workerInUse = true;
-        availableWorkerID = candidateWorkerID;
-        workersLock.unlock();
-        break;
-      }
-    }
-
     queueLock.lock();
-    function<void(void)> currentThunk = thunkQueue.front();
-    thunkQueue.pop();
+    chrono::steady_clock::time_point now = chrono::steady_clock::now();
+    for (size_t workerID = 0; workerID < workerVector.size() && numQueued > 0; workerID++) {
+      workerStruct& worker = workerVector[workerID];
+      if (!worker.idle.load(memory_order_acquire)) continue;
+      queue<queuedThunkStruct> *source = selectQueue(workerID);
+      if (source == NULL) continue;
+      worker.idle.store(false, memory_order_relaxed);
+      recordQueueDelay(now - source->front().enqueued, now);
+      assignments.push_back(make_pair(workerID, std::move(source->front().thunk)));
+      source->pop();
+      numQueued--;
+    }
     queueLock.unlock();
 
-    workersLock.lock();
-    workerVector[availableWorkerID].workerThunk = currentThunk;
-    workerVector[availableWorkerID].thunkToExecute.signal();
-    workersLock.unlock();
+    for (pair<size_t, function<void(void)>>& assignment : assignments) {
+      workerStruct& worker = workerVector[assignment.first];
+      if (!worker.workerThread.joinable()) worker.workerThread = thread(&ThreadPool::worker, this, assignment.first);
+      deliver(assignment.first, assignment.second);
+    }
+    assignments.clear();
+  }
+}
+
+queue<ThreadPool::queuedThunkStruct> *ThreadPool::selectQueue(size_t workerID) {
+  if (!workerVector[workerID].affinityQueue.empty()) return &workerVector[workerID].affinityQueue;
+  if (!thunkQueue.empty()) return &thunkQueue;
+  // Otherwise keyed thunks wait for their own worker, unless it has more than it can get to soon.
+  queue<queuedThunkStruct> *mostBackedUp = NULL;
+  for (workerStruct& worker : workerVector) {
+    if (worker.affinityQueue.size() > kMaxAffinityBacklog &&
+        (mostBackedUp == NULL || worker.affinityQueue.size() > mostBackedUp->size())) {
+      mostBackedUp = &worker.affinityQueue;
+    }
+  }
+  return mostBackedUp;
+}
+
+void ThreadPool::deliver(size_t workerID, const function<void(void)>& thunk) {
+  workerStruct& worker = workerVector[workerID];
+  worker.mailbox = thunk;
+  worker.mailboxFull.store(true, memory_order_release);
+
+  // The worker sets parked before its last look at the mailbox, so either it sees this thunk or we see it parked.
+  worker.deliveries.fetch_add(1, memory_order_seq_cst);
+  if (worker.parked.load(memory_order_seq_cst)) futexWake(worker.deliveries);
+}
+
+function<void(void)> ThreadPool::receive(size_t workerID) {
+  workerStruct& worker = workerVector[workerID];
+  while (true) {
+    uint32_t deliveries = worker.deliveries.load(memory_order_seq_cst);
+    if (worker.mailboxFull.load(memory_order_acquire)) {
+      function<void(void)> thunk = std::move(worker.mailbox);
+      worker.mailbox = nullptr;
+      worker.mailboxFull.store(false, memory_order_release);
+      return thunk;
+    }
+    worker.parked.store(true, memory_order_seq_cst);
+    if (!worker.mailboxFull.load(memory_order_seq_cst)) {
+      futexWait(worker.deliveries, deliveries); // returns at once if a delivery has bumped the word since
+    }
+    worker.parked.store(false, memory_order_relaxed);
   }
 }
 
 void ThreadPool::worker(size_t workerID) {
   while (true) {
-    workerVector[workerID].thunkToExecute.wait();
+    function<void(void)> thunk = receive(workerID);
 
-    if (exitFlag) {
+    if (!thunk) { // The destructor's way of saying there's nothing left.
       break;
     }
 
-    workerVector[workerID].workerThunk();
+    thunk();
+    EpochReclaimer::getInstance().quiescent(); // Thunks never hold guards across each other.
 
     pendingThunksLock.lock();
     pendingThunks--;
@@ -84,11 +196,8 @@ void ThreadPool::worker(size_t workerID) {
     }
     pendingThunksLock.unlock();
 
-    workersLock.lock();
-    workerVector[workerID].workerInUse = false;
-    workersLock.unlock();
-
-    workerIsAvailable.signal();
+    workerVector[workerID].idle.store(true, memory_order_release);
+    dispatcherEvents.signal();
   }
 }
 
@@ -100,15 +209,21 @@ void ThreadPool::wait() {
 }
 
 ThreadPool::~ThreadPool() {
+  timersLock.lock();
+  timersExitFlag = true;
+  timersCondVar.notify_one();
+  timersLock.unlock();
+  if (timerThread.joinable()) timerThread.join();
+
   wait();
   exitFlag = true;
 
-  for (size_t workerID = 0; workerID < nextSpawnID; workerID++) {
-    workerVector[workerID].thunkToExecute.signal();
+  for (size_t workerID = 0; workerID < workerVector.size(); workerID++) {
+    if (!workerVector[workerID].workerThread.joinable()) continue; // Never needed, so never spawned.
+    deliver(workerID, nullptr);
     workerVector[workerID].workerThread.join();
   }
 
-  newThunkFromScheduler.signal(); 
-  workerIsAvailable.signal();
+  dispatcherEvents.signal();
   dispatcherThread.join();
 }
@@ -13,14 +13,19 @@
 #define _thread_pool_
 
 #include <unistd.h>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <condition_variable>
 #include <cstdlib>
 #include <functional>
 #include <iostream>
 #include <queue>
+#include <string>
 #include <thread>
 #include <vector>
 #include <mutex>
-#include <semaphore.h>
+#include "fast-semaphore.h"
 
 
 // place additional #include statements here
@@ -50,6 +55,47 @@ class ThreadPool {
    */
   void schedule(const std::function<void(void)>& thunk);
 
+  /**
+   * Schedules the provided thunk as schedule does, but with a soft affinity
+   * for the one worker the supplied key hashes to, so that thunks sharing a
+   * key (articles from one host, say) tend to run on the same thread and find
+   * its caches warm.  The thunk waits for that worker while it's busy, unless
+   * the worker is backed up, in which case any idle worker may steal it.
+   * Keyed thunks therefore shouldn't wait on other thunks in the same pool.
+   */
+  void schedule(const std::string& key, const std::function<void(void)>& thunk);
+
+  /**
+   * Schedules the provided thunk as schedule does, unless admission control
+   * is on and the pool is overloaded, in which case the thunk is rejected:
+   * it's discarded and false is returned, and the caller may retry later or
+   * give up.  Meant for low-priority work that can stand to be deferred.
+   */
+  bool trySchedule(const std::function<void(void)>& thunk);
+
+  /**
+   * Schedules the provided thunk as schedule does, but only once the
+   * specified delay has elapsed.  Until then the thunk doesn't count as
+   * scheduled, so wait() doesn't wait for it, and thunks whose timers
+   * haven't expired when the ThreadPool is destroyed are discarded.
+   *
+   * If onRejected is supplied, the thunk is low priority: it's scheduled
+   * as trySchedule does when the timer expires, and onRejected is called
+   * instead (on the timer thread, so it should be quick) if it's rejected.
+   */
+  void scheduleAfter(std::chrono::steady_clock::duration delay, const std::function<void(void)>& thunk,
+                     const std::function<void(void)>& onRejected = nullptr);
+
+  /**
+   * Turns on admission control, after the manner of CoDel.  The time each
+   * thunk spends queued is measured as it's dispatched, and once it has stayed
+   * above target for a full interval the pool is overloaded, and trySchedule
+   * rejects thunks until one is dispatched within target again.  A queue whose
+   * oldest thunk has waited longer than interval is overloaded too, even if
+   * no thunk has been dispatched to measure by.  An empty queue never is.
+   */
+  void setAdmissionControl(std::chrono::steady_clock::duration target, std::chrono::steady_clock::duration interval);
+
   /**
    * Blocks and waits until all previously scheduled thunks
    * have been executed in full.
@@ -58,55 +104,127 @@ class ThreadPool {
 
  private:
   
-  typedef struct workerStruct {
-    workerStruct() : workerInUse(false){};
+  static const size_t kMaxAffinityBacklog = 2; // A worker with more keyed thunks waiting for it is backed up.
+
+  typedef struct queuedThunkStruct {
+    std::function<void(void)> thunk; // Self-explanatory.
+    std::chrono::steady_clock::time_point enqueued; // When it was scheduled, to measure how long it waited.
+  } queuedThunkStruct;
+
+  // Each worker gets cache lines of its own, so the dispatcher handing one worker a thunk
+  // never invalidates the line another worker is polling.
+  typedef struct alignas(64) workerStruct {
     std::thread workerThread; // Self-explanatory.
-    std::function<void(void)> workerThunk; // Self-explanatory.
-    semaphore thunkToExecute; // Binary coordination case used to track when the thunk should be run.
-    bool workerInUse; // Self-explanatory.
+    std::function<void(void)> mailbox; // The thunk handed over by the dispatcher, while mailboxFull is set.
+    std::atomic<bool> mailboxFull{false}; // Set by the dispatcher as it delivers, cleared by the worker as it takes.
+    std::atomic<uint32_t> deliveries{0}; // Futex word the worker parks on; bumped with every delivery.
+    std::atomic<bool> parked{false}; // Set while the worker is (about to be) asleep on deliveries.
+    std::atomic<bool> idle{true}; // Cleared by the dispatcher when it claims the worker, set by the worker when done.
+    std::queue<queuedThunkStruct> affinityQueue; // Keyed thunks waiting for this worker (protected by queueLock).
   } workerStruct;
 
+  typedef struct timerStruct {
+    std::chrono::steady_clock::time_point deadline; // When the thunk should be scheduled.
+    size_t sequence; // Breaks ties between equal deadlines in the order the timers were set.
+    std::function<void(void)> timerThunk; // Self-explanatory.
+    std::function<void(void)> onRejected; // Called if the thunk is low priority and turned away.
+    bool operator>(const timerStruct& other) const {
+      return deadline > other.deadline || (deadline == other.deadline && sequence > other.sequence);
+    }
+  } timerStruct;
+
   std::vector<workerStruct> workerVector; // Vector of worker structs.
   std::thread dispatcherThread; // Single thread for the dispatcher.
 
-  std::queue<std::function<void(void)>> thunkQueue; // Used to store the thunks waiting for worker assignment.
+  std::queue<queuedThunkStruct> thunkQueue; // Used to store the unkeyed thunks waiting for worker assignment.
+  size_t numQueued = 0; // Thunks waiting in thunkQueue and the affinity queues (protected by queueLock).
+
+  // Admission control state, all protected by queueLock.  A zero target means it's off.
+  std::chrono::steady_clock::duration admissionTarget{0};
+  std::chrono::steady_clock::duration admissionInterval{0};
+  std::chrono::steady_clock::time_point firstAboveTarget; // When the wait will have been above target for an interval.
+  bool overloaded = false; // Set once it has, and cleared by the first wait below target.
 
-  int nextSpawnID; // Used to store the ID of the next worker to be spawned.
   int pendingThunks; // Used to store count of remaining thunks.
-  bool exitFlag; // Used to indicate that execution is in the destructor.
+  std::atomic<bool> exitFlag; // Used to indicate that execution is in the destructor (read by the dispatcher on every event).
 
-  std::mutex workersLock; // Used to protect access to the worker vector.
   std::mutex queueLock; // Used to protect access to the queue of thunks.
   std::mutex pendingThunksLock; // Used to protect access to the thunk counter.
-  std::mutex nextSpawnIDLock; // Used to protect access to the nexr worker index.
 
   std::condition_variable_any pendingThunksCondVar; // Used to track if there are any thunks left.
 
-  semaphore workerIsAvailable; // Permits case used to track worker count.
-  semaphore newThunkFromScheduler; // Binary coordination case used to track when the scheduler has a new thunk for the dispatcher.
+  std::priority_queue<timerStruct, std::vector<timerStruct>, std::greater<timerStruct>> timerQueue; // Earliest deadline first.
+  std::thread timerThread; // Started by the first call to scheduleAfter.
+  size_t nextTimerSequence; // Used to store the sequence number of the next timer.
+  bool timersExitFlag; // Used to tell the timer thread to stop.
+  std::mutex timersLock; // Used to protect access to the timer queue and the two fields above.
+  std::condition_variable timersCondVar; // Used to wake the timer thread for an earlier deadline or exit.
+
+  FastSemaphore dispatcherEvents; // Signaled whenever a thunk is queued or a worker goes idle.
+  std::vector<std::pair<size_t, std::function<void(void)>>> assignments; // Reused by the dispatcher.
 
   /**
-   * Waits for a thunk to be added to the queue.
-   * Waits for a worker thread to become available.
-   * Selects an available worker.
-   * Marks the worker as unavailable.
-   * Removes the thunk from the queue.
-   * Pushes the thunk to the worker.
-   * Signals the worker to begin execution.
+   * Waits for a thunk to be queued or a worker to go idle.
+   * Pairs each idle worker with the thunk it should run next, if any, spawning the worker if need be.
+   * Removes those thunks from their queues.
+   * Delivers each thunk to its worker's mailbox, waking the worker if it's parked.
    */
   void dispatcher();
 
   /**
-   * Waits for the dispatcher to signal it to start.
-   * Executes the thunk that it holds (updated by the dispatcher!).
-   * Marks itself as available once again.
+   * Returns the queue the specified idle worker should take its next thunk
+   * from: its own affinity queue, failing that the unkeyed queue, and failing
+   * that the affinity queue of the most backed-up worker.  Returns NULL if
+   * there's nothing it should run.  Called with queueLock held.
+   */
+  std::queue<queuedThunkStruct> *selectQueue(size_t workerID);
+
+  /**
+   * Adds the supplied thunk to the supplied queue and increments the thunk counter,
+   * unless shedIfOverloaded is true and the pool is overloaded.  Returns
+   * whether the thunk was queued.
+   */
+  bool enqueue(std::queue<queuedThunkStruct>& queue, const std::function<void(void)>& thunk, bool shedIfOverloaded);
+
+  /**
+   * Updates the admission control state with the time a thunk just dequeued
+   * spent waiting.  Called with queueLock held.
+   */
+  void recordQueueDelay(std::chrono::steady_clock::duration delay, std::chrono::steady_clock::time_point now);
+
+  /**
+   * Delivers the supplied thunk to the specified worker's mailbox.  Only the
+   * dispatcher (and the destructor, once the dispatcher is idle) calls this,
+   * so each mailbox has a single producer and needs no lock.  A mailbox holds
+   * one thunk: only idle workers are handed thunks, and a worker empties its
+   * mailbox before running what it took, so the slot is always free.
+   */
+  void deliver(size_t workerID, const std::function<void(void)>& thunk);
+
+  /**
+   * Takes the next thunk from the specified worker's mailbox, parking on a
+   * futex only while the mailbox is empty.
+   */
+  std::function<void(void)> receive(size_t workerID);
+
+  /**
+   * Receives and executes thunks until it receives an empty one.
+   * Reports a quiescent state to the EpochReclaimer and marks itself as idle once again after each.
    * Also decrements the thunk counter, signaling end of life for the executed thunk.
    */
   void worker(size_t workerID);
 
+  /**
+   * Sleeps until the earliest timer expires (or an earlier one is set),
+   * then hands its thunk to schedule.  Runs until the destructor sets
+   * the timers' exit flag.
+   */
+  void timekeeper();
+
   ThreadPool(const ThreadPool& original) = delete;
   ThreadPool& operator=(const ThreadPool& rhs) = delete;
 };
 
-#endif
 }
+
+#endif
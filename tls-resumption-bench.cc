@@ -0,0 +1,107 @@
+/**
+ * File: tls-resumption-bench.cc
+ * -----------------------------
+ * A standalone benchmark that measures what resuming TLS sessions through
+ * the TLSSessionCache saves.  It opens the supplied number of connections to
+ * an https URL one after another, each from a fresh easy handle that may not
+ * reuse an earlier connection, first with every handle on its own (so each
+ * pays for a full handshake) and then with every handle attached to the
+ * cache (so all but the first resume a session), and reports the handshake
+ * times libcurl recorded (CURLINFO_APPCONNECT_TIME minus
+ * CURLINFO_CONNECT_TIME) for each.
+ *
+ * Usage: tls-resumption-bench <https-url> <ca-file> [<connections>]
+ *
+ * The CA file is the certificate the server presents, so that a local
+ * server with a self-signed certificate can be used, for instance:
+ *
+ *   openssl req -x509 -newkey rsa:2048 -nodes -subj /CN=localhost \
+ *       -keyout key.pem -out cert.pem -days 1
+ *   openssl s_server -accept 8443 -cert cert.pem -key key.pem -www &
+ *   tls-resumption-bench https://localhost:8443/ cert.pem
+ */
+
+#include <curl/curl.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "tls-session-cache.h"
+using namespace std;
+
+static const size_t kDefaultNumConnections = 200;
+
+static size_t discardBody(char *, size_t size, size_t count, void *) {
+  return size * count;
+}
+
+// Returns the handshake time of each successful connection, in microseconds, sorted.
+static vector<double> connect(const string& url, const string& caFile, size_t numConnections, bool resume,
+                              size_t& numFailed) {
+  vector<double> handshakes;
+  numFailed = 0;
+  for (size_t i = 0; i < numConnections; i++) {
+    CURL *easy = curl_easy_init();
+    curl_easy_setopt(easy, CURLOPT_URL, url.c_str());
+    curl_easy_setopt(easy, CURLOPT_CAINFO, caFile.c_str());
+    curl_easy_setopt(easy, CURLOPT_WRITEFUNCTION, discardBody);
+    curl_easy_setopt(easy, CURLOPT_FRESH_CONNECT, 1L);
+    curl_easy_setopt(easy, CURLOPT_FORBID_REUSE, 1L);
+    curl_easy_setopt(easy, CURLOPT_NOSIGNAL, 1L);
+    if (resume) TLSSessionCache::getInstance().attach(easy);
+    else curl_easy_setopt(easy, CURLOPT_SSL_SESSIONID_CACHE, 0L);
+
+    curl_off_t connected = 0, handshaken = 0;
+    if (curl_easy_perform(easy) == CURLE_OK &&
+        curl_easy_getinfo(easy, CURLINFO_CONNECT_TIME_T, &connected) == CURLE_OK &&
+        curl_easy_getinfo(easy, CURLINFO_APPCONNECT_TIME_T, &handshaken) == CURLE_OK) {
+      handshakes.push_back(handshaken - connected);
+    } else {
+      numFailed++;
+    }
+    curl_easy_cleanup(easy);
+  }
+  sort(handshakes.begin(), handshakes.end());
+  return handshakes;
+}
+
+static void printHandshakes(const string& label, const vector<double>& handshakes, size_t numFailed) {
+  cout << label << ": " << handshakes.size() << " connections, " << numFailed << " failed";
+  if (!handshakes.empty()) {
+    double total = 0;
+    for (double handshake : handshakes) total += handshake;
+    cout << ", handshakes take " << total / handshakes.size() << " us on average, "
+         << handshakes[handshakes.size() / 2] << " us median, "
+         << handshakes[handshakes.size() * 99 / 100] << " us at the 99th percentile";
+  }
+  cout << endl;
+}
+
+int main(int argc, char *argv[]) {
+  if (argc < 3 || argc > 4) {
+    cerr << "Usage: " << argv[0] << " <https-url> <ca-file> [<connections>]" << endl;
+    return 1;
+  }
+  string url = argv[1], caFile = argv[2];
+  if (url.compare(0, 8, "https://") != 0) {
+    cerr << "\"" << url << "\" isn't an https URL." << endl;
+    return 1;
+  }
+  size_t numConnections = kDefaultNumConnections;
+  if (argc == 4) numConnections = strtoul(argv[3], NULL, 10);
+  if (numConnections == 0) {
+    cerr << "The number of connections must be positive." << endl;
+    return 1;
+  }
+
+  curl_global_init(CURL_GLOBAL_DEFAULT);
+  size_t numFailed;
+  vector<double> full = connect(url, caFile, numConnections, false, numFailed);
+  printHandshakes("full handshakes", full, numFailed);
+  vector<double> resumed = connect(url, caFile, numConnections, true, numFailed);
+  printHandshakes("resumed through TLSSessionCache", resumed, numFailed);
+  return full.empty() || resumed.empty() ? 1 : 0;
+}
@@ -0,0 +1,39 @@
+/**
+ * File: tls-session-cache.cc
+ * --------------------------
+ * Presents the implementation of the TLSSessionCache class.
+ */
+
+#include "tls-session-cache.h"
+using namespace std;
+
+TLSSessionCache& TLSSessionCache::getInstance() {
+  static TLSSessionCache instance;
+  return instance;
+}
+
+TLSSessionCache::TLSSessionCache() {
+  share = curl_share_init();
+  curl_share_setopt(share, CURLSHOPT_LOCKFUNC, lock);
+  curl_share_setopt(share, CURLSHOPT_UNLOCKFUNC, unlock);
+  curl_share_setopt(share, CURLSHOPT_USERDATA, this);
+  curl_share_setopt(share, CURLSHOPT_SHARE, CURL_LOCK_DATA_SSL_SESSION);
+  curl_share_setopt(share, CURLSHOPT_SHARE, CURL_LOCK_DATA_DNS);
+}
+
+TLSSessionCache::~TLSSessionCache() {
+  curl_share_cleanup(share);
+}
+
+void TLSSessionCache::attach(CURL *easy) {
+  curl_easy_setopt(easy, CURLOPT_SHARE, share);
+  curl_easy_setopt(easy, CURLOPT_SSL_SESSIONID_CACHE, 1L);
+}
+
+void TLSSessionCache::lock(CURL *, curl_lock_data data, curl_lock_access, void *userptr) {
+  static_cast<TLSSessionCache *>(userptr)->locks[data].lock();
+}
+
+void TLSSessionCache::unlock(CURL *, curl_lock_data data, void *userptr) {
+  static_cast<TLSSessionCache *>(userptr)->locks[data].unlock();
+}
@@ -0,0 +1,50 @@
+/**
+ * File: tls-session-cache.h
+ * -------------------------
+ * Defines the TLSSessionCache class, the one process-wide store of the TLS
+ * sessions (and resolved addresses) every HttpFetcher connection draws on.
+ * Most articles live on a few dozen https servers, and a connection that
+ * can't resume a session pays for a full handshake: an extra round trip,
+ * and a certificate chain to verify.  Sharing the cache across fetchers
+ * means any new connection to a host resumes the session an earlier one
+ * established, whichever worker or fetcher opened it.
+ *
+ * Sessions are keyed by host and port (and TLS configuration) and are
+ * resumed with whatever the server offers, including TLS 1.3 session tickets.
+ */
+
+#pragma once
+#include <curl/curl.h>
+
+#include <mutex>
+
+class TLSSessionCache {
+ public:
+/**
+ * Static Method: getInstance
+ * --------------------------
+ * Returns the process-wide cache, creating it the first time through.
+ * libcurl must already have been initialized.
+ */
+  static TLSSessionCache& getInstance();
+
+/**
+ * Method: attach
+ * --------------
+ * Makes the supplied easy handle store and resume its sessions through
+ * this cache.  Must be called before the handle's transfer starts.
+ */
+  void attach(CURL *easy);
+
+ private:
+  CURLSH *share;
+  std::mutex locks[CURL_LOCK_DATA_LAST]; // One per kind of shared data, so DNS lookups don't wait on sessions.
+
+  TLSSessionCache();
+  ~TLSSessionCache();
+  static void lock(CURL *easy, curl_lock_data data, curl_lock_access access, void *userptr);
+  static void unlock(CURL *easy, curl_lock_data data, void *userptr);
+
+  TLSSessionCache(const TLSSessionCache& original) = delete;
+  TLSSessionCache& operator=(const TLSSessionCache& rhs) = delete;
+};
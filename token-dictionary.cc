@@ -0,0 +1,39 @@
+/**
+ * File: token-dictionary.cc
+ * -------------------------
+ * Presents the implementation of the TokenDictionary class.
+ */
+
+#include "token-dictionary.h"
+using namespace std;
+
+TokenID TokenDictionary::intern(const string& term) {
+  Stripe& stripe = stripeFor(term);
+  lock_guard<mutex> lg(stripe.lock);
+  auto found = stripe.ids.find(term);
+  if (found != stripe.ids.end()) return found->second;
+  TokenID id = nextID.fetch_add(1, memory_order_relaxed);
+  stripe.ids.emplace(term, id);
+  return id;
+}
+
+bool TokenDictionary::find(const string& term, TokenID& id) const {
+  const Stripe& stripe = stripeFor(term);
+  lock_guard<mutex> lg(stripe.lock);
+  auto found = stripe.ids.find(term);
+  if (found == stripe.ids.end()) return false;
+  id = found->second;
+  return true;
+}
+
+vector<string> TokenDictionary::getTerms() const {
+  vector<string> terms(size());
+  for (const Stripe& stripe : stripes) {
+    lock_guard<mutex> lg(stripe.lock);
+    for (const pair<const string, TokenID>& entry : stripe.ids) {
+      // IDs handed out after size() was sampled are skipped; they belong to a later snapshot.
+      if (entry.second < terms.size()) terms[entry.second] = entry.first;
+    }
+  }
+  return terms;
+}
@@ -0,0 +1,78 @@
+/**
+ * File: token-dictionary.h
+ * ------------------------
+ * Defines the TokenDictionary class, which assigns every distinct term a small,
+ * dense integer ID.  The dictionary is split into independently locked stripes
+ * (chosen by hashing the term) so that many threads can intern terms at once
+ * without all of them contending for a single lock.
+ */
+
+#pragma once
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+typedef uint32_t TokenID;
+
+/**
+ * Struct: TokenCount
+ * ------------------
+ * One run of a pre-aggregated token list: a token ID and the number of
+ * times it occurs.  Lists of these are kept sorted by ID.
+ */
+struct TokenCount {
+  TokenID id;
+  int count;
+};
+
+class TokenDictionary {
+ public:
+/**
+ * Method: intern
+ * --------------
+ * Returns the ID of the supplied term, assigning it the next free
+ * ID if it has never been seen before.  Safe to call from any thread.
+ */
+  TokenID intern(const std::string& term);
+
+/**
+ * Method: find
+ * ------------
+ * Looks up the ID of the supplied term without assigning one.  Returns
+ * true and populates id if the term is known, and false otherwise.
+ */
+  bool find(const std::string& term, TokenID& id) const;
+
+/**
+ * Method: size
+ * ------------
+ * Returns the number of distinct terms interned so far.
+ */
+  size_t size() const { return nextID.load(std::memory_order_relaxed); }
+
+/**
+ * Method: getTerms
+ * ----------------
+ * Returns every interned term, indexed by its ID.
+ */
+  std::vector<std::string> getTerms() const;
+
+ private:
+  static const size_t kNumStripes = 64;
+
+  // Each stripe sits on its own cache line so neighbouring locks don't ping-pong.
+  struct alignas(64) Stripe {
+    mutable std::mutex lock;
+    std::unordered_map<std::string, TokenID> ids;
+  };
+
+  std::array<Stripe, kNumStripes> stripes;
+  std::atomic<TokenID> nextID{0};
+
+  Stripe& stripeFor(const std::string& term) { return stripes[std::hash<std::string>()(term) % kNumStripes]; }
+  const Stripe& stripeFor(const std::string& term) const { return stripes[std::hash<std::string>()(term) % kNumStripes]; }
+};
@@ -0,0 +1,91 @@
+/**
+ * File: token-normalizer.cc
+ * -------------------------
+ * Presents the implementation of the TokenNormalizer class.
+ */
+
+#include "token-normalizer.h"
+
+#include <algorithm>
+
+#include "porter-stemmer.h"
+#include "text-normalization.h"
+using namespace std;
+
+static const unordered_set<string> kStopWords = {
+  "a", "about", "above", "after", "again", "against", "all", "am", "an", "and",
+  "any", "are", "as", "at", "be", "because", "been", "before", "being", "below",
+  "between", "both", "but", "by", "can", "could", "did", "do", "does", "doing",
+  "down", "during", "each", "few", "for", "from", "further", "had", "has", "have",
+  "having", "he", "her", "here", "hers", "herself", "him", "himself", "his", "how",
+  "i", "if", "in", "into", "is", "it", "its", "itself", "just", "me", "more",
+  "most", "my", "myself", "no", "nor", "not", "now", "of", "off", "on", "once",
+  "only", "or", "other", "our", "ours", "ourselves", "out", "over", "own", "same",
+  "she", "should", "so", "some", "such", "than", "that", "the", "their", "theirs",
+  "them", "themselves", "then", "there", "these", "they", "this", "those", "through",
+  "to", "too", "under", "until", "up", "very", "was", "we", "were", "what", "when",
+  "where", "which", "while", "who", "whom", "why", "will", "with", "would", "you",
+  "your", "yours", "yourself", "yourselves",
+};
+
+TokenNormalizer::TokenNormalizer(const Options& options)
+  : options(options), prunedTerms(make_shared<const unordered_set<TokenID>>()) {}
+
+bool TokenNormalizer::normalize(string& token) const {
+  normalizeText(token);
+  return reduce(token);
+}
+
+bool TokenNormalizer::reduce(string& token) const {
+  if (token.empty()) return false;
+  if (options.removeStopWords && kStopWords.count(token)) return false;
+  if (options.stem) porterStem(token);
+  return true;
+}
+
+void TokenNormalizer::normalizeAll(vector<string>& tokens) const {
+  size_t kept = 0;
+  for (size_t i = 0; i < tokens.size(); i++) {
+    if (!reduce(tokens[i])) continue;
+    if (kept != i) tokens[kept] = move(tokens[i]);
+    kept++;
+  }
+  tokens.resize(kept);
+}
+
+size_t TokenNormalizer::pruneFrequentTerms(const vector<vector<TokenCount> *>& documents) {
+  if (options.maxDocumentFrequency >= 1.0) return 0;
+  if (documents.size() < options.minDocumentsForPruning) return 0;
+
+  // Token IDs are dense and each list holds an ID at most once, so a flat counter array suffices.
+  vector<size_t> documentFrequencies;
+  for (const vector<TokenCount> *tokens : documents) {
+    if (tokens->empty()) continue;
+    if (tokens->back().id >= documentFrequencies.size()) documentFrequencies.resize(tokens->back().id + 1);
+    for (const TokenCount& token : *tokens) documentFrequencies[token.id]++;
+  }
+
+  size_t limit = options.maxDocumentFrequency * documents.size();
+  vector<bool> pruned(documentFrequencies.size(), false);
+  shared_ptr<unordered_set<TokenID>> allPruned = make_shared<unordered_set<TokenID>>(*atomic_load(&prunedTerms));
+  size_t numPruned = 0;
+  for (TokenID id = 0; id < documentFrequencies.size(); id++) {
+    if (documentFrequencies[id] <= limit) continue;
+    pruned[id] = true;
+    allPruned->insert(id);
+    numPruned++;
+  }
+  if (numPruned == 0) return 0;
+  atomic_store(&prunedTerms, shared_ptr<const unordered_set<TokenID>>(allPruned));
+
+  for (vector<TokenCount> *tokens : documents) {
+    tokens->erase(remove_if(tokens->begin(), tokens->end(),
+                            [&pruned](const TokenCount& token) { return pruned[token.id]; }),
+                  tokens->end());
+  }
+  return numPruned;
+}
+
+bool TokenNormalizer::isPruned(TokenID id) const {
+  return atomic_load(&prunedTerms)->count(id) > 0;
+}
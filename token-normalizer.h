@@ -0,0 +1,88 @@
+/**
+ * File: token-normalizer.h
+ * ------------------------
+ * Defines the TokenNormalizer class, which sits between MainContentDocument::getTokens
+ * and the index.  Each token is dropped if it's a stop word and otherwise
+ * reduced to its Porter stem.  Article text has already been through
+ * normalizeText (see text-normalization.h) as a whole by then; search terms
+ * go through it one at a time here.  Once the crawl is done, terms that appear in too
+ * large a fraction of the articles can be pruned as well.  The same normalizer
+ * is applied to search terms so that queries and articles always agree.
+ */
+
+#pragma once
+#include <memory>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+#include "token-dictionary.h"
+
+class TokenNormalizer {
+ public:
+/**
+ * Struct: Options
+ * ---------------
+ * Knobs controlling each stage of the pipeline.  Document-frequency pruning
+ * only kicks in once at least minDocumentsForPruning articles have been
+ * collected, since tiny crawls have wildly unrepresentative frequencies.
+ * A maxDocumentFrequency of 1.0 or more disables pruning altogether.
+ */
+  struct Options {
+    bool removeStopWords = true;
+    bool stem = true;
+    double maxDocumentFrequency = 0.5;
+    size_t minDocumentsForPruning = 100;
+  };
+
+/**
+ * Constructor: TokenNormalizer
+ * ----------------------------
+ * Constructs a normalizer configured with the supplied options.
+ */
+  TokenNormalizer(const Options& options);
+
+/**
+ * Method: normalize
+ * -----------------
+ * Normalizes the supplied token in place, starting with normalizeText.
+ * Returns false if the token should be dropped altogether (it's empty or a
+ * stop word).
+ */
+  bool normalize(std::string& token) const;
+
+/**
+ * Method: normalizeAll
+ * --------------------
+ * Normalizes every token in the supplied vector, compacting away the ones
+ * that normalize rejects.  The tokens are taken to have come from text that
+ * normalizeText was already applied to, so that stage isn't repeated.
+ */
+  void normalizeAll(std::vector<std::string>& tokens) const;
+
+/**
+ * Method: pruneFrequentTerms
+ * --------------------------
+ * Accepts the ID-sorted token counts of every article, computes each term's
+ * document frequency, and removes every term whose frequency exceeds the
+ * configured threshold from all of them.  Pruned terms are remembered so
+ * that isPruned can explain why a query found nothing: the set of them is
+ * never modified once published, and is replaced wholesale, so queries can
+ * consult it while the crawl thread prunes.  Returns the number of terms
+ * pruned.
+ */
+  size_t pruneFrequentTerms(const std::vector<std::vector<TokenCount> *>& documents);
+
+/**
+ * Method: isPruned
+ * ----------------
+ * Returns true if and only if the supplied term was removed by pruneFrequentTerms.
+ * Safe to call from any thread.
+ */
+  bool isPruned(TokenID id) const;
+
+ private:
+  Options options;
+  bool reduce(std::string& token) const;
+  std::shared_ptr<const std::unordered_set<TokenID>> prunedTerms; // Only ever accessed with atomic_load and atomic_store.
+};